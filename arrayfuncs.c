@@ -20,13 +20,24 @@ along with this program; if not, see <https://www.gnu.org/licenses>.
  */
 
 #include <assert.h>
+#include <ctype.h>
 #include <errno.h>
+#include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
+
+#include <regex.h>
+#ifdef HAVE_PCRE2
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
+#endif
 
 #include "gawkapi.h"
 
@@ -57,13 +68,61 @@ struct subarrays {
 
   awk_flat_array_t *source_flat_array;
   awk_flat_array_t *dest_flat_array;
+
+  // set only by functions which need them:
+  size_t depth;  // 0 for the top array
+  char *path;    // subarray's indexes joined by SUBSEP, NULL for the top array
+};
+
+struct strmap_item {
+  char *key;     // NULL for free slots
+  size_t len;
+  uint64_t hash;
+  size_t value;
+};
+
+struct strmap {
+  struct strmap_item *items;
+  size_t size;   // always a power of 2
+  size_t count;
+};
+
+#define _REGEX_CACHE_SIZE 16
+
+struct regex_cache_item {
+  char *pattern;  // NULL for free slots
+  size_t len;
+  int pcre;       // PCRE2 syntax, POSIX ERE otherwise
+  unsigned long used;
+#ifdef HAVE_PCRE2
+  pcre2_code *code;
+  pcre2_match_data *match_data;
+#endif
+  regex_t re;
 };
 
+// compiled patterns, least recently used ones are replaced first
+static struct regex_cache_item regex_cache[_REGEX_CACHE_SIZE];
+static unsigned long regex_cache_tick = 0;
+
 static awk_value_t * do_equals(int nargs, awk_value_t *result, struct awk_ext_func *finfo);
 static awk_value_t * do_copy(int nargs, awk_value_t *result, struct awk_ext_func *finfo);
 static awk_value_t * do_deep_flat(int nargs, awk_value_t *result, struct awk_ext_func *finfo);
 static awk_value_t * do_deep_flat_idx(int nargs, awk_value_t *result, struct awk_ext_func *finfo);
 static awk_value_t * do_uniq(int nargs, awk_value_t *result, struct awk_ext_func *finfo);
+static awk_value_t * do_slice(int nargs, awk_value_t *result, struct awk_ext_func *finfo);
+static awk_value_t * do_range(int nargs, awk_value_t *result, struct awk_ext_func *finfo);
+static awk_value_t * do_memsize(int nargs, awk_value_t *result, struct awk_ext_func *finfo);
+static awk_value_t * do_sample(int nargs, awk_value_t *result, struct awk_ext_func *finfo);
+static awk_value_t * do_transpose(int nargs, awk_value_t *result, struct awk_ext_func *finfo);
+static awk_value_t * do_pivot(int nargs, awk_value_t *result, struct awk_ext_func *finfo);
+static awk_value_t * do_merge_sorted(int nargs, awk_value_t *result, struct awk_ext_func *finfo);
+static awk_value_t * do_grep(int nargs, awk_value_t *result, struct awk_ext_func *finfo);
+static awk_value_t * do_pipeline(int nargs, awk_value_t *result, struct awk_ext_func *finfo);
+static awk_value_t * do_uniq_rows(int nargs, awk_value_t *result, struct awk_ext_func *finfo);
+static awk_value_t * do_partition(int nargs, awk_value_t *result, struct awk_ext_func *finfo);
+static awk_value_t * do_to_number(int nargs, awk_value_t *result, struct awk_ext_func *finfo);
+static awk_value_t * do_to_string(int nargs, awk_value_t *result, struct awk_ext_func *finfo);
 //XXX+TODO: add depth parameter to flat to the given depth only
 
 
@@ -76,6 +135,19 @@ static awk_ext_func_t func_table[] = {
   { "deep_flat", do_deep_flat, 2, 2, awk_false, NULL },
   { "deep_flat_idx", do_deep_flat_idx, 2, 2, awk_false, NULL },
   { "uniq", do_uniq, 2, 2, awk_false, NULL },
+  { "slice", do_slice, 5, 4, awk_false, NULL },
+  { "range", do_range, 4, 3, awk_false, NULL },
+  { "memsize", do_memsize, 2, 1, awk_false, NULL },
+  { "sample", do_sample, 6, 3, awk_false, NULL },
+  { "transpose", do_transpose, 2, 2, awk_false, NULL },
+  { "pivot", do_pivot, 3, 3, awk_false, NULL },
+  { "merge_sorted", do_merge_sorted, 4, 3, awk_true, NULL }, // more arrays allowed, no lint
+  { "grep", do_grep, 6, 3, awk_false, NULL },
+  { "pipeline", do_pipeline, 3, 3, awk_false, NULL },
+  { "uniq_rows", do_uniq_rows, 3, 2, awk_false, NULL },
+  { "partition", do_partition, 5, 3, awk_false, NULL },
+  { "to_number", do_to_number, 3, 1, awk_false, NULL },
+  { "to_string", do_to_string, 3, 1, awk_false, NULL },
 };
 
 __attribute__((unused)) static awk_bool_t (*init_func)(void) = NULL;
@@ -163,6 +235,19 @@ compare_element(awk_value_t item1, awk_value_t item2)
 }
 
 
+void
+fatal_if_same_array(awk_array_t array1, awk_array_t array2, const char *what)
+{
+  /*
+   * Exits with a fatal error (about trying to $what an array
+   * on itself) if $array1 and $array2 are the same array.
+   */
+  //XXX+TODO: test if works... not found a better way... seems no api facilities...
+  if (array1 == array2)
+    fatal(ext_id, "trying to %s an array on itself!", what);
+}
+
+
 struct subarrays*
 alloc_subarray_list(struct subarrays *list, size_t new_size)
 {
@@ -175,6 +260,25 @@ alloc_subarray_list(struct subarrays *list, size_t new_size)
 }
 
 
+struct subarrays*
+grow_subarray_list(struct subarrays *list, size_t size, size_t *maxsize)
+{
+  /*
+   * Makes room in $list for (at least) one more item at index $size,
+   * updating $maxsize if a reallocation is needed.
+   * To be called before *every* append, not only once per traversal step,
+   * since an array can hold more subarrays than the list's spare room.
+   * Returns the (possibly moved) $list, exits with a fatal error if fails.
+   */
+  if (size >= *maxsize-1) {
+    *maxsize *= 10;
+    if (NULL == (list = alloc_subarray_list(list, *maxsize)))
+      fatal(ext_id, "Can't reallocate array lists: %s", strerror(errno));
+  }
+  return list;
+}
+
+
 int
 release_subarrays(struct subarrays *list,
 			  size_t idx,
@@ -183,20 +287,21 @@ release_subarrays(struct subarrays *list,
    * Releases the struct subarrays $list up to $idx index,
    * calling release_flattened_array() on the source_* arrays member
    * if $rs is true and on the dest_* arrays member ig $rd is true.
+   * NULL flattened arrays (empty arrays, see NOTE_A) are skipped.
    * Returns true if success, false otherwise.
    */
   size_t i;
   int result = 1;
   dprint("Release flattened array...\n");
   for (i=0; i < idx; i++) {
-    if (rs) { // release source arrays
+    if (rs && list[i].source_flat_array != NULL) { // release source arrays
       if (! release_flattened_array(list[i].source_array,
 				    list[i].source_flat_array)) {
 	result = 0;
 	dprint("in release_flattened_array() at index %ld [source array]\n", i);
       }
     }
-    if (rd) { // release dest arrays
+    if (rd && list[i].dest_flat_array != NULL) { // release dest arrays
       if (! release_flattened_array(list[i].dest_array,
 				    list[i].dest_flat_array)) {
 	result = 0;
@@ -208,6 +313,465 @@ release_subarrays(struct subarrays *list,
 }
 
 
+const char*
+get_subsep(size_t *len)
+{
+  /*
+   * Returns the current value of SUBSEP, storing its length in $len.
+   * Exits with a fatal error if fails.
+   */
+  awk_value_t subsep;
+  if (! sym_lookup("SUBSEP", AWK_STRING, & subsep))
+    fatal(ext_id, "can't retrieve SUBSEP");
+  *len = subsep.str_value.len;
+  return subsep.str_value.str;
+}
+
+
+char*
+make_path(const char *parent, awk_value_t index,
+	  const char *subsep, size_t subsep_len)
+{
+  /*
+   * Builds the path of the element at $index (which must be an AWK_STRING,
+   * as the flatten_array_typed() indexes used here) of the array
+   * having path $parent (NULL for the top array), that is
+   * $parent $subsep $index. Same as the awk's multidimensional indexes.
+   * Returns the malloc'd path (to be free()d), exits with a fatal error if fails.
+   */
+  char *path;
+  size_t plen = (parent == NULL) ? 0 : strlen(parent) + subsep_len;
+
+  if (NULL == (path = malloc(plen + index.str_value.len + 1)))
+    fatal(ext_id, "Can't allocate path: %s", strerror(errno));
+  if (parent != NULL) {
+    memcpy(path, parent, plen - subsep_len);
+    memcpy(path + plen - subsep_len, subsep, subsep_len);
+  }
+  memcpy(path + plen, index.str_value.str, index.str_value.len);
+  path[plen + index.str_value.len] = '\0';
+  return path;
+}
+
+
+int
+value_to_number(awk_value_t val, double *num)
+{
+  /*
+   * Converts the scalar $val to a number, the awk's way: strings
+   * are converted using their leading numeric part (0 if missing),
+   * hex strings and unsigned inf or nan are not numbers.
+   * Sets $num to the converted value and returns 1 if $val
+   * is (or entirely looks like) a number, 0 otherwise.
+   */
+  const char *str, *p;
+  char *end;
+
+  switch (val.val_type) {
+  case AWK_NUMBER:
+    *num = val.num_value;
+    return 1;
+#ifdef AWK_BOOL
+  case AWK_BOOL:
+    *num = val.bool_value;
+    return 1;
+#endif
+  case AWK_STRING: case AWK_STRNUM: case AWK_REGEX:
+    *num = 0;
+    str = p = val.str_value.str;
+    while (isspace((unsigned char) *p))
+      p++;
+    if (*p == '+' || *p == '-') {
+      p++;
+    } else if (isalpha((unsigned char) *p)) {
+      return 0;  // unsigned inf/nan
+    }
+    if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+      return 0;  // leading 0 only
+    }
+    *num = strtod(str, & end);
+    if (end == str)
+      return 0;
+    while (isspace((unsigned char) *end))
+      end++;
+    return (*end == '\0');
+  case AWK_UNDEFINED:
+    *num = 0;
+    return 1;
+  default:
+    *num = 0;
+    return 0;
+  }
+}
+
+
+uint64_t
+rand_seed(double seed)
+{
+  /*
+   * Returns a (never zero) state for rand_next(), from $seed (splitmix64).
+   */
+  uint64_t z;
+  if (seed > -9.2e18 && seed < 9.2e18)
+    z = (uint64_t) (int64_t) seed;
+  else
+    memcpy(& z, & seed, sizeof(z));  // inf, nan or huge, use its bits
+  z += 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z ^= z >> 31;
+  return z ? z : 0x9E3779B97F4A7C15ULL;
+}
+
+
+uint64_t
+rand_next(uint64_t *state)
+{
+  /*
+   * Returns the next pseudo-random number from $state (xorshift64*),
+   * not touching the awk's rand() state.
+   */
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 0x2545F4914F6CDD1DULL;
+}
+
+
+double
+rand_unit(uint64_t *state)
+{
+  /*
+   * Returns a pseudo-random number in (0, 1) from $state.
+   */
+  return ((rand_next(state) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+
+uint64_t
+hash_bytes(const char *str, size_t len, uint64_t hash)
+{
+  /*
+   * Returns the hash of the $len bytes at $str (FNV-1a), starting
+   * from $hash (0 for a new one), so can be used on several chunks.
+   */
+  size_t i;
+  if (hash == 0)
+    hash = 0xCBF29CE484222325ULL;
+  for (i = 0; i < len; i++) {
+    hash ^= (unsigned char) str[i];
+    hash *= 0x100000001B3ULL;
+  }
+  return hash;
+}
+
+
+void
+strmap_init(struct strmap *map, size_t size)
+{
+  /*
+   * Initializes the string map $map, for about $size keys.
+   * Exits with a fatal error if fails.
+   */
+  map->size = 16;
+  while (map->size < size * 2)
+    map->size *= 2;
+  map->count = 0;
+  if (NULL == (map->items = calloc(map->size, sizeof(struct strmap_item))))
+    fatal(ext_id, "Can't allocate string map: %s", strerror(errno));
+}
+
+
+void
+strmap_free(struct strmap *map)
+{
+  /*
+   * Releases the memory used by $map.
+   */
+  size_t i;
+  for (i = 0; i < map->size; i++)
+    free(map->items[i].key);
+  free(map->items);
+  map->items = NULL;
+  map->size = map->count = 0;
+}
+
+
+size_t*
+strmap_get(struct strmap *map, const char *key, size_t len, int *found)
+{
+  /*
+   * Looks for $key (of length $len) in $map, adding it if missing.
+   * Sets $found to 1 if $key was already there, 0 otherwise.
+   * Returns a pointer to the key's value, valid until the next call.
+   * Exits with a fatal error if fails.
+   */
+  struct strmap_item *old;
+  size_t i, pos, old_size;
+  uint64_t hash = hash_bytes(key, len, 0);
+
+  if ((map->count + 1) * 2 > map->size) {
+    // grow and rehash
+    old = map->items;
+    old_size = map->size;
+    map->size *= 2;
+    if (NULL == (map->items = calloc(map->size, sizeof(struct strmap_item))))
+      fatal(ext_id, "Can't reallocate string map: %s", strerror(errno));
+    for (i = 0; i < old_size; i++) {
+      if (old[i].key == NULL)
+	continue;
+      for (pos = old[i].hash & (map->size - 1);
+	   map->items[pos].key != NULL;
+	   pos = (pos + 1) & (map->size - 1))
+	;
+      map->items[pos] = old[i];
+    }
+    free(old);
+  }
+  for (pos = hash & (map->size - 1);
+       map->items[pos].key != NULL;
+       pos = (pos + 1) & (map->size - 1)) {
+    if (map->items[pos].hash == hash
+	&& map->items[pos].len == len
+	&& ! memcmp(map->items[pos].key, key, len)) {
+      *found = 1;
+      return & map->items[pos].value;
+    }
+  }
+  if (NULL == (map->items[pos].key = malloc(len + 1)))
+    fatal(ext_id, "Can't allocate string map key: %s", strerror(errno));
+  memcpy(map->items[pos].key, key, len);
+  map->items[pos].key[len] = '\0';
+  map->items[pos].len = len;
+  map->items[pos].hash = hash;
+  map->items[pos].value = 0;
+  map->count += 1;
+  *found = 0;
+  return & map->items[pos].value;
+}
+
+
+int
+_compare_elements_index(const void *a, const void *b)
+{
+  /*
+   * Private qsort() function for sort_flat_by_index().
+   * Compares two awk_element_t * by index, as gawk's @ind_num_asc:
+   * numeric indexes (nan excluded) come first, sorted by value,
+   * then the others, sorted as strings; numeric ties are sorted
+   * as strings too, so that the order is total.
+   */
+  const awk_element_t *e1 = *(awk_element_t * const *) a;
+  const awk_element_t *e2 = *(awk_element_t * const *) b;
+  double n1, n2;
+  int is_num1 = value_to_number(e1->index, & n1) && ! isnan(n1);
+  int is_num2 = value_to_number(e2->index, & n2) && ! isnan(n2);
+  if (is_num1 != is_num2)
+    return is_num2 - is_num1;
+  if (is_num1 && n1 != n2)
+    return (n1 > n2) - (n1 < n2);
+  return strcmp(e1->index.str_value.str, e2->index.str_value.str);
+}
+
+
+awk_element_t**
+sort_flat_by_index(awk_flat_array_t *flat)
+{
+  /*
+   * Returns a malloc'd list of pointers to the elements of $flat,
+   * sorted by index (see _compare_elements_index()).
+   * Exits with a fatal error if fails.
+   */
+  size_t i;
+  awk_element_t **sorted;
+  if (NULL == (sorted = malloc(sizeof(awk_element_t *) * (flat->count + 1))))
+    fatal(ext_id, "Can't allocate sorted elements: %s", strerror(errno));
+  for (i = 0; i < flat->count; i++)
+    sorted[i] = & flat->elements[i];
+  qsort(sorted, flat->count, sizeof(awk_element_t *), _compare_elements_index);
+  return sorted;
+}
+
+
+const char*
+get_convfmt(void)
+{
+  /*
+   * Returns the current value of CONVFMT.
+   * Exits with a fatal error if fails.
+   */
+  awk_value_t convfmt;
+  if (! sym_lookup("CONVFMT", AWK_STRING, & convfmt))
+    fatal(ext_id, "can't retrieve CONVFMT");
+  return convfmt.str_value.str;
+}
+
+
+const char*
+scalar_to_str(awk_value_t val, char *buf, size_t bufsize,
+	      const char *convfmt, size_t *len)
+{
+  /*
+   * Returns the string value of the scalar $val, the awk's way:
+   * integral numbers are printed as integers, the others using $convfmt.
+   * $buf (of size $bufsize) is used for numbers, strings are returned as is.
+   * Sets $len to the string's length.
+   */
+  double num;
+  switch (val.val_type) {
+  case AWK_STRING: case AWK_STRNUM: case AWK_REGEX:
+    *len = val.str_value.len;
+    return val.str_value.str;
+  case AWK_UNDEFINED:
+    *len = 0;
+    return "";
+  default:
+    value_to_number(val, & num);
+    if (num > -1e18 && num < 1e18 && num == (double) (long long) num)
+      snprintf(buf, bufsize, "%lld", (long long) num);
+    else
+      snprintf(buf, bufsize, convfmt, num);
+    *len = strlen(buf);
+    return buf;
+  }
+}
+
+
+struct regex_cache_item*
+get_regex(const char *pattern, size_t len, int pcre)
+{
+  /*
+   * Returns the compiled $pattern (of length $len) from the regex cache,
+   * compiling it (and possibly replacing the least recently used one)
+   * if not yet there. $pattern is an extended POSIX regex, whatever
+   * the build, or a PCRE2 one (compiled with JIT, if supported) if $pcre
+   * is true, which needs the extension compiled with HAVE_PCRE2.
+   * Exits with a fatal error if $pattern is not a valid regex.
+   */
+  size_t i, slot = 0;
+  struct regex_cache_item *item;
+  char errbuf[256];
+  int errcode;
+#ifdef HAVE_PCRE2
+  PCRE2_SIZE erroffset;
+#else
+  if (pcre)
+    fatal(ext_id, "PCRE2 regexes need arrayfuncs compiled with HAVE_PCRE2");
+#endif
+
+  for (i = 0; i < _REGEX_CACHE_SIZE; i++) {
+    item = & regex_cache[i];
+    if (item->pattern != NULL && item->pcre == pcre
+	&& item->len == len && ! memcmp(item->pattern, pattern, len)) {
+      dprint("regex cache hit: <%s>\n", pattern);
+      item->used = ++regex_cache_tick;
+      return item;
+    }
+    if (item->pattern == NULL || item->used < regex_cache[slot].used)
+      slot = i;
+    if (item->pattern == NULL)
+      break;
+  }
+
+  item = & regex_cache[slot];
+  if (item->pattern != NULL) {
+    dprint("regex cache evict: <%s>\n", item->pattern);
+#ifdef HAVE_PCRE2
+    if (item->pcre) {
+      pcre2_match_data_free(item->match_data);
+      pcre2_code_free(item->code);
+    } else
+#endif
+      regfree(& item->re);
+    free(item->pattern);
+    item->pattern = NULL;
+  }
+#ifdef HAVE_PCRE2
+  if (pcre) {
+    if (NULL == (item->code = pcre2_compile((PCRE2_SPTR) pattern, len, 0,
+					    & errcode, & erroffset, NULL))) {
+      pcre2_get_error_message(errcode, (PCRE2_UCHAR *) errbuf, sizeof(errbuf));
+      fatal(ext_id, "Invalid regex <%s>: %s", pattern, errbuf);
+    }
+    pcre2_jit_compile(item->code, PCRE2_JIT_COMPLETE);  // if not supported, plain matching is used
+    if (NULL == (item->match_data = pcre2_match_data_create_from_pattern(item->code, NULL)))
+      fatal(ext_id, "Can't allocate regex match data");
+  } else
+#endif
+  if (0 != (errcode = regcomp(& item->re, pattern, REG_EXTENDED | REG_NOSUB))) {
+    regerror(errcode, & item->re, errbuf, sizeof(errbuf));
+    fatal(ext_id, "Invalid regex <%s>: %s", pattern, errbuf);
+  }
+  item->pcre = pcre;
+  if (NULL == (item->pattern = malloc(len + 1)))
+    fatal(ext_id, "Can't allocate regex cache: %s", strerror(errno));
+  memcpy(item->pattern, pattern, len);
+  item->pattern[len] = '\0';
+  item->len = len;
+  item->used = ++regex_cache_tick;
+  return item;
+}
+
+
+int
+regex_match(struct regex_cache_item *item, const char *str, size_t len)
+{
+  /*
+   * Returns 1 if the $str string (of length $len, NUL terminated)
+   * matches the compiled regex $item, 0 otherwise.
+   * The whole $len bytes are matched, embedded NULs included, but with
+   * POSIX regexes on systems without REG_STARTEND, where the match
+   * stops at the first NUL.
+   */
+#ifdef REG_STARTEND
+  regmatch_t range;
+#endif
+#ifdef HAVE_PCRE2
+  if (item->pcre)
+    return pcre2_match(item->code, (PCRE2_SPTR) str, len, 0, 0, item->match_data, NULL) >= 0;
+#endif
+#ifdef REG_STARTEND
+  range.rm_so = 0;
+  range.rm_eo = (regoff_t) len;
+  return regexec(& item->re, str, 1, & range, REG_STARTEND) == 0;
+#else
+  (void) len;
+  return regexec(& item->re, str, 0, NULL, 0) == 0;
+#endif
+}
+
+
+awk_array_t
+set_subarray(awk_array_t array, awk_value_t *index)
+{
+  /*
+   * Creates a new subarray in $array at $index (which is consumed).
+   * Returns the new subarray, exits with a fatal error if fails.
+   */
+  awk_value_t arr_value;
+  arr_value.val_type = AWK_ARRAY;              // *** MANDATORY ***
+  arr_value.array_cookie = create_array();     // *** MANDATORY ***
+  if (! set_array_element(array, index, & arr_value))
+    fatal(ext_id, "set_array_element() failed on subarray");
+  return arr_value.array_cookie;               // *** MANDATORY -- after set_array_element() ***
+}
+
+
+void
+set_str_num(awk_array_t array, const char *index, double num)
+{
+  /*
+   * Sets $array[$index] = $num.
+   * Exits with a fatal error if fails.
+   */
+  awk_value_t index_val, value_val;
+  make_const_string(index, strlen(index), & index_val);
+  make_number(num, & value_val);
+  if (! set_array_element(array, & index_val, & value_val))
+    fatal(ext_id, "set_array_element() failed at index <%s>", index);
+}
+
+
 struct subarrays*
 _deep_flat(struct subarrays *list,
 	   awk_array_t *dest_array,
@@ -242,6 +806,7 @@ _deep_flat(struct subarrays *list,
 			      & list[*idx].source_flat_array,
 			      AWK_STRING, AWK_UNDEFINED)) {
       dprint("could not flatten source array (idx = %zu)\n", *idx);
+      list[*idx].source_flat_array = NULL;
       *idx += 1;
       continue;
     }
@@ -256,6 +821,7 @@ _deep_flat(struct subarrays *list,
 	if (list[*idx].source_flat_array->elements[i].value.val_type == AWK_ARRAY) {
 	  // is a subarray, save it and procede
 	  dprint("subarray at index <%zu> (size: %zu)\n", i, *size);
+	  list = grow_subarray_list(list, *size, maxsize);
 	  list[*size].source_array = list[*idx].source_flat_array->elements[i].value.array_cookie;
 	  *size += 1;
 	} else {
@@ -314,6 +880,7 @@ _deep_flat_idx(struct subarrays *list,
 			      AWK_STRING, AWK_UNDEFINED)) {
       // skip, see NOTE_A
       dprint("could not flatten source array (idx = <%zu>)\n", *idx);
+      list[*idx].source_flat_array = NULL;
       *idx += 1;
       continue;
     }
@@ -327,6 +894,7 @@ _deep_flat_idx(struct subarrays *list,
 	if (list[*idx].source_flat_array->elements[i].value.val_type == AWK_ARRAY) {
 	  // is a subarray, save it for later but *also* set the index val
 	  dprint("subarray at index <%zu> (size: %zu)\n", i, *size);
+	  list = grow_subarray_list(list, *size, maxsize);
 	  list[*size].source_array = list[*idx].source_flat_array->elements[i].value.array_cookie;
 	  *size += 1;
 	} else {
@@ -356,64 +924,128 @@ _deep_flat_idx(struct subarrays *list,
 }
 
 
-/***********************/
-/* EXTENSION FUNCTIONS */
-/***********************/
+struct subarrays*
+_deep_copy(struct subarrays *list,
+	   size_t *idx,
+	   size_t *size,
+	   size_t *maxsize)
+{
+  /*
+   * Private function to copy arrays.
+   * Given a $list of <struct subarrays *>, copies every source_array
+   * of the structs in $list (starting from $idx up to $size) into the
+   * corresponding dest_array, creating the needed subarrays on the way.
+   * Elements already present in the dest arrays are *not* deleted.
+   * Returns $list, or NULL if fails.
+   */
+  size_t i;
 
-static awk_value_t*
-do_equals(int nargs,
-	  awk_value_t *result,
-	  __attribute__((unused)) struct awk_ext_func *finfo)
+  if (*idx >= *size)
+    return list;
+  do {
+    dprint("idx, size, maxsize = <%zu> <%zu> <%zu>\n", *idx, *size, *maxsize);
+    list = grow_subarray_list(list, *size, maxsize);
+
+    /* flat the array */
+    if (! flatten_array_typed(list[*idx].source_array,
+			      & list[*idx].source_flat_array,
+			      AWK_STRING, AWK_UNDEFINED)) {
+      // skip possibly empty subarrays et similia, see NOTE_A
+      list[*idx].source_flat_array = NULL;
+      *idx += 1;
+      continue;
+    }
+
+    dprint("list[%zu].flat_array->count = <%zu> items\n",
+	   *idx, list[*idx].source_flat_array->count);
+    for (i = 0; i < list[*idx].source_flat_array->count; i++)  {
+      if (! copy_element(list[*idx].source_flat_array->elements[i].index,
+			 & list[*idx].dest_index_val)) {
+	fatal(ext_id,
+	      "copy_element() failed at array index <%zu> "
+	      "(arraylist index: %zu)",
+	      i, *idx);
+      }
+      if (! copy_element(list[*idx].source_flat_array->elements[i].value,
+			 & list[*idx].dest_value_val)) {
+	if (list[*idx].source_flat_array->elements[i].value.val_type == AWK_ARRAY) {
+	  /* is a subarray, save it and procede */
+	  dprint("subarray at index <%zu>\n", i);
+	  list = grow_subarray_list(list, *size, maxsize);
+	  list[*size].dest_array = create_array();
+	  list[*size].dest_arr_value.val_type = AWK_ARRAY;                    // *** MANDATORY ***
+	  list[*size].dest_arr_value.array_cookie = list[*size].dest_array;   // *** MANDATORY ***
+
+	  if (! set_array_element(list[*idx].dest_array,
+				  & list[*idx].dest_index_val,
+				  & list[*size].dest_arr_value)) {
+	    fatal(ext_id,
+		  "set_array_element() failed on subarray at index <%zu>",
+		  *idx);
+	  }
+	  list[*size].source_array = list[*idx].source_flat_array->elements[i].value.array_cookie;
+	  list[*size].dest_array = list[*size].dest_arr_value.array_cookie; // *** MANDATORY -- after set_array_element() ***
+	  *size += 1;
+	} else {
+	  fatal(ext_id,
+		"Unknown element at index <%zu> (val_type=%d)",
+		i, list[*idx].dest_value_val.val_type);
+	}
+      } else {
+	if (! set_array_element(list[*idx].dest_array,
+				& list[*idx].dest_index_val,
+				& list[*idx].dest_value_val)) {
+	  fatal(ext_id,
+		"set_array_element() failed on value at index <%zu>", *idx);
+	}
+      }
+    }
+    *idx += 1;
+  } while (*idx < *size);
+  return list;
+}
+
+
+int
+_equals(awk_array_t array1, awk_array_t array2)
 {
-  /* 
-   * Returns true if the array at $nargs[0]
-   * equals the array at $nargs[1], else false.
-   * Exits with a fatal error if there are big issues.
+  /*
+   * Private function to compare arrays.
+   * Returns 1 if $array1 equals $array2 (same indexes and values,
+   * of the same types, in the same order, subarrays included),
+   * 0 otherwise.
    * NOTE: comparing deleted arrays always evaluate to false.
    */
-  assert(result != NULL);
-  make_number(0.0, result);
-  if (nargs != 2)
-    fatal(ext_id, "two args expected: array_1, array_2");
-
   struct subarrays *list = NULL;
   size_t i, idx = 0;
   size_t size = 0;
   size_t maxsize = 10;
-  
+  int equal = 0;
+
   if (NULL == (list = alloc_subarray_list(list, maxsize)))
     fatal(ext_id, "Can't allocate array lists!");
 
-  /* SOURCE ARRAY */
-  if (! get_argument(0, AWK_ARRAY, & list[size].source_arr_value))
-    fatal(ext_id, "can't retrieve array (1st arg)");
-
-  /* DEST ARRAY */
-  if (! get_argument(1, AWK_ARRAY, & list[size].dest_arr_value))
-    fatal(ext_id, "can't retrieve array (2nd arg)");
-
-  list[size].dest_array = list[size].dest_arr_value.array_cookie;     /*** MANDATORY ***/
-  list[size].source_array = list[size].source_arr_value.array_cookie; /*** MANDATORY ***/
+  list[size].source_array = array1;
+  list[size].dest_array = array2;
   size += 1;
-  
+
   do {
     dprint("idx, size, maxsize = %zu %zu %zu\n", idx, size, maxsize);
-    if (size >= maxsize-1) {
-      maxsize *= 10;
-      if (NULL == (list = alloc_subarray_list(list, maxsize)))
-	fatal(ext_id, "Can't reallocate arrays list: %s", strerror(errno));
-    }
+    list[idx].source_flat_array = NULL;
+    list[idx].dest_flat_array = NULL;
     /* flat the arrays */
     if (! flatten_array_typed(list[idx].source_array,
 			      & list[idx].source_flat_array,
 			      AWK_STRING, AWK_UNDEFINED)) {
       dprint("could not flatten (1st) array\n");
+      list[idx].source_flat_array = NULL;
       goto out;
     }
     if (! flatten_array_typed(list[idx].dest_array,
 			      & list[idx].dest_flat_array,
 			      AWK_STRING, AWK_UNDEFINED)) {
       dprint("could not flatten (2nd) array\n");
+      list[idx].dest_flat_array = NULL;
       goto out;
     }
 
@@ -436,6 +1068,12 @@ do_equals(int nargs,
 	goto out;
       }
       if (list[idx].source_flat_array->elements[i].value.val_type == AWK_ARRAY) {
+	if (! compare_element(list[idx].source_flat_array->elements[i].index,
+			      list[idx].dest_flat_array->elements[i].index)) {
+	  dprint("compare_element returns false (subarray index) at index <%zu>", idx);
+	  goto out;
+	}
+	list = grow_subarray_list(list, size, & maxsize);
 	list[size].source_array = list[idx].source_flat_array->elements[i].value.array_cookie;
 	list[size].dest_array = list[idx].dest_flat_array->elements[i].value.array_cookie;
 	size += 1;
@@ -452,11 +1090,153 @@ do_equals(int nargs,
     idx += 1;
   } while (idx < size);
   
-  make_number(1.0, result);
+  equal = 1;
  out:
-  /* MANDATORY -- must be called before exit */
-  release_subarrays(list, idx, 1, 1);
+  /* MANDATORY -- must be called before exit, on the current item too */
+  release_subarrays(list, (idx < size ? idx + 1 : idx), 1, 1);
+  free(list);
+  return equal;
+}
+
+
+uint64_t
+hash_mix(uint64_t hash)
+{
+  /*
+   * Returns $hash with its bits mixed (splitmix64's finalizer),
+   * for when the low bits are used, e.g. hash % N.
+   */
+  hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBULL;
+  return hash ^ (hash >> 31);
+}
+
+
+uint64_t
+hash_value(awk_value_t val)
+{
+  /*
+   * Returns the hash of the scalar $val, its type included,
+   * so that values compare_element() finds equal hash the same.
+   */
+  char type = (char) val.val_type;
+  uint64_t hash = hash_bytes(& type, 1, 0);
+  double num;
+  switch (val.val_type) {
+  case AWK_STRING: case AWK_REGEX: case AWK_STRNUM:
+    return hash_bytes(val.str_value.str, val.str_value.len, hash);
+  case AWK_NUMBER:
+    num = (val.num_value == 0) ? 0.0 : val.num_value; // -0 == 0
+    return hash_bytes((const char *) & num, sizeof(num), hash);
+#ifdef AWK_BOOL
+  case AWK_BOOL:
+    return hash_bytes((const char *) & val.bool_value, sizeof(val.bool_value), hash);
+#endif
+  default:
+    return hash;
+  }
+}
+
+
+uint64_t
+hash_element(awk_value_t index, uint64_t value_hash)
+{
+  /*
+   * Returns the hash of an (index, value) pair, given
+   * the $index and the hash of the value, $value_hash.
+   * Pairs' hashes can be summed up in any order.
+   */
+  // mixed, so the sum of pairs spreads well
+  return hash_mix(hash_value(index) ^ (value_hash * 0x9E3779B97F4A7C15ULL));
+}
+
+
+uint64_t
+hash_array(awk_array_t array)
+{
+  /*
+   * Returns the hash of the contents of $array, subarrays included,
+   * regardless of the elements' order.
+   * Equal arrays (see _equals()) hash the same, but different ones
+   * can collide, i.e. the hash must be confirmed with _equals().
+   * Exits with a fatal error if fails.
+   */
+  struct subarrays *list = NULL;
+  awk_flat_array_t *flat;
+  uint64_t hash = 0;
+  char subarray_mark = (char) AWK_ARRAY;
+  size_t i, idx = 0;
+  size_t size = 0;
+  size_t maxsize = 10;
+
+  if (NULL == (list = alloc_subarray_list(list, maxsize)))
+    fatal(ext_id, "Can't allocate array lists: %s", strerror(errno));
+  list[size].source_array = array;
+  list[size].depth = 0;
+  size += 1;
+
+  do {
+    if (! flatten_array_typed(list[idx].source_array,
+			      & list[idx].source_flat_array,
+			      AWK_STRING, AWK_UNDEFINED)) {
+      // skip, see NOTE_A
+      list[idx].source_flat_array = NULL;
+      idx += 1;
+      continue;
+    }
+    flat = list[idx].source_flat_array;
+    for (i = 0; i < flat->count; i++) {
+      if (flat->elements[i].value.val_type == AWK_ARRAY) {
+	// contents are summed up later, mark only the level here
+	hash += hash_element(flat->elements[i].index,
+			     hash_bytes(& subarray_mark, 1, list[idx].depth + 1));
+	list = grow_subarray_list(list, size, & maxsize);
+	list[size].source_array = flat->elements[i].value.array_cookie;
+	list[size].depth = list[idx].depth + 1;
+	size += 1;
+      } else {
+	hash += hash_element(flat->elements[i].index,
+			     hash_value(flat->elements[i].value) + list[idx].depth);
+      }
+    }
+    idx += 1;
+  } while (idx < size);
+
+  release_subarrays(list, idx, 1, 0);
   free(list);
+  return hash;
+}
+
+
+/***********************/
+/* EXTENSION FUNCTIONS */
+/***********************/
+
+static awk_value_t*
+do_equals(int nargs,
+	  awk_value_t *result,
+	  __attribute__((unused)) struct awk_ext_func *finfo)
+{
+  /* 
+   * Returns true if the array at $nargs[0]
+   * equals the array at $nargs[1], else false.
+   * Exits with a fatal error if there are big issues.
+   * NOTE: comparing deleted arrays always evaluate to false.
+   */
+  assert(result != NULL);
+  make_number(0.0, result);
+  if (nargs != 2)
+    fatal(ext_id, "two args expected: array_1, array_2");
+
+  awk_value_t array1_value, array2_value;
+
+  if (! get_argument(0, AWK_ARRAY, & array1_value))
+    fatal(ext_id, "can't retrieve array (1st arg)");
+  if (! get_argument(1, AWK_ARRAY, & array2_value))
+    fatal(ext_id, "can't retrieve array (2nd arg)");
+
+  if (_equals(array1_value.array_cookie, array2_value.array_cookie))
+    make_number(1.0, result);
   return result;
 }
 
@@ -477,10 +1257,9 @@ do_copy(int nargs,
   make_number(0.0, result);
   
   struct subarrays *list = NULL;
-  size_t i, idx = 0;
+  size_t idx = 0;
   size_t size = 0;
   size_t maxsize = 10;
-  awk_valtype_t ret;
   
   if (nargs != 2)
     fatal(ext_id, "two args expected: source, dest");
@@ -495,79 +1274,15 @@ do_copy(int nargs,
   if (! get_argument(1, AWK_ARRAY, & list[size].dest_arr_value))
     fatal(ext_id, "can't retrieve dest array");
     
-  //XXX+TODO: test if works... not found a better way... seems no api facilities...
-  if (list[size].source_arr_value.array_cookie == list[size].dest_arr_value.array_cookie)
-    fatal(ext_id, "trying to copy an array on itself!");
+  fatal_if_same_array(list[size].source_arr_value.array_cookie,
+		      list[size].dest_arr_value.array_cookie, "copy");
 
   list[size].dest_array = list[size].dest_arr_value.array_cookie;     /*** MANDATORY ***/
   list[size].source_array = list[size].source_arr_value.array_cookie; /*** MANDATORY ***/
 
   size += 1;
   
-  do {
-    dprint("idx, size, maxsize = <%zu> <%zu> <%zu>\n", idx, size, maxsize);
-    if (size >= maxsize-1) {
-      maxsize *= 10;
-      if (NULL == (list = alloc_subarray_list(list, maxsize)))
-	fatal(ext_id, "Can't reallocate array lists: %s", strerror(errno));
-    }
-    
-    /* flat the array */
-    if (! flatten_array_typed(list[idx].source_array,
-			      & list[idx].source_flat_array,
-			      AWK_STRING, AWK_UNDEFINED)) {
-      // skip possibly empty subarrays et similia, see NOTE_A
-      idx += 1;
-      continue;
-    }
-
-    dprint("list[%zu].flat_array->count = <%zu> items\n",
-	   idx, list[idx].source_flat_array->count);
-    for (i = 0; i < list[idx].source_flat_array->count; i++)  {
-      if (! copy_element(list[idx].source_flat_array->elements[i].index,
-			 & list[idx].dest_index_val)) {
-	fatal(ext_id,
-	      "copy_element() failed at array index <%zu> "
-	      "(arraylist index: %zu)",
-	      i, idx);
-      }
-      if (! (ret = copy_element(list[idx].source_flat_array->elements[i].value,
-				& list[idx].dest_value_val))) {
-	if (list[idx].source_flat_array->elements[i].value.val_type == AWK_ARRAY) {
-	  /* is a subarray, save it and procede */
-	  dprint("subarray at index <%zu>\n", i);
-	  list[size].dest_array = create_array();
-	  list[size].dest_arr_value.val_type = AWK_ARRAY;                   // *** MANDATORY ***
-	  list[size].dest_arr_value.array_cookie = list[size].dest_array;   // *** MANDATORY ***
-	
-	  if (! set_array_element(list[idx].dest_array,
-				  & list[idx].dest_index_val,
-				  & list[size].dest_arr_value)) {
-	    fatal(ext_id,
-		  "set_array_element() failed on subarray at index <%zu>",
-		  idx);
-	    //size -=1;
-	    //goto out;
-	  }
-	  list[size].source_array = list[idx].source_flat_array->elements[i].value.array_cookie;
-	  list[size].dest_array = list[size].dest_arr_value.array_cookie; // *** MANDATORY -- after set_array_element() ***
-	  size += 1;
-	} else {
-	  fatal(ext_id,
-		"Unknown element at index <%zu> (val_type=%d)",
-		i, list[idx].dest_value_val.val_type);
-	}
-      } else {
-	if (! set_array_element(list[idx].dest_array,
-				& list[idx].dest_index_val,
-				& list[idx].dest_value_val)) {
-	  fatal(ext_id,
-		"set_array_element() failed on value at index <%zu>", idx);
-	}
-      }
-    }
-    idx += 1;
-  } while (idx < size);
+  list = _deep_copy(list, & idx, & size, & maxsize);
 
   make_number(1.0, result);
 
@@ -614,9 +1329,8 @@ do_deep_flat(int nargs,
   if (! get_argument(1, AWK_ARRAY, & dest_arr_value))
     fatal(ext_id, "can't retrieve dest array");
 
-  //XXX+TODO: test if works... not found a better way... seems no api facilities...
-  if (list[size].source_arr_value.array_cookie == dest_arr_value.array_cookie)
-    fatal(ext_id, "trying to flat an array on itself!");
+  fatal_if_same_array(list[size].source_arr_value.array_cookie,
+		      dest_arr_value.array_cookie, "flat");
 
 
   dest_array = dest_arr_value.array_cookie;                            // *** MANDATORY ***
@@ -669,9 +1383,8 @@ do_deep_flat_idx(int nargs,
   if (! get_argument(1, AWK_ARRAY, & dest_arr_value))
     fatal(ext_id, "can't retrieve dest array");
 
-  //XXX+TODO: test if works... not found a better way... seems no api facilities...
-  if (list[size].source_arr_value.array_cookie == dest_arr_value.array_cookie)
-    fatal(ext_id, "trying to flat an array on itself!");
+  fatal_if_same_array(list[size].source_arr_value.array_cookie,
+		      dest_arr_value.array_cookie, "flat");
 
   dest_array = dest_arr_value.array_cookie;                            /*** MANDATORY ***/
   list[size].source_array = list[size].source_arr_value.array_cookie;  /*** MANDATORY ***/
@@ -735,9 +1448,8 @@ do_uniq(int nargs,
   if (! get_argument(1, AWK_ARRAY, & dest_arr_value))
     fatal(ext_id, "can't retrieve dest array");
   
-  //XXX+TODO: test if works... not found a better way... seems no api facilities...
-  if (list[size].source_arr_value.array_cookie == dest_arr_value.array_cookie)
-    fatal(ext_id, "trying to uniq() an array on itself!");
+  fatal_if_same_array(list[size].source_arr_value.array_cookie,
+		      dest_arr_value.array_cookie, "uniq()");
   
   if (nargs > 2) {
     if (! get_argument(2, AWK_STRING, & what))
@@ -821,10 +1533,2741 @@ do_uniq(int nargs,
 
 
 
+// largest (absolute) slice position, integers are exact up to here
+#define _SLICE_MAX_POS 9007199254740992.0  // 2^53
+
+
+static awk_value_t*
+do_slice(int nargs,
+	 awk_value_t *result,
+	 __attribute__((unused)) struct awk_ext_func *finfo)
+{
+  /*
+   * Copies into the $nargs[1] array the elements of the $nargs[0] array
+   * found at the integer indexes from $nargs[2] to $nargs[3] (both
+   * inclusive) moving by $nargs[4] (optional, defaults to 1, may be negative),
+   * *without* deleting elements already present in the latter.
+   * Elements are fetched one by one, so only the requested window is visited
+   * (missing indexes are skipped). Subarrays are copied as a whole.
+   * The slice will be indexed with integer values starting from 0.
+   * Positions and step must be within +/-2^53 and the step must be
+   * a whole number (fatal error otherwise).
+   * Exits with a fatal error if there are big issues, returns the number
+   * of copied elements.
+   */
+  assert(result != NULL);
+  make_number(0.0, result);
+
+  struct subarrays *list = NULL;
+  awk_value_t source_arr_value;
+  awk_value_t dest_arr_value;
+  awk_value_t from_val, to_val, step_val;
+  awk_value_t index_val;
+  awk_value_t value_val;
+  awk_value_t dest_idx_val;
+  awk_value_t dest_value_val;
+  awk_array_t source_array;
+  awk_array_t dest_array;
+
+  long long pos, from, to, step = 1;
+  size_t dest_idx = 0;
+  size_t idx = 0;
+  size_t size = 0;
+  size_t maxsize = 10;
+
+  if (nargs < 4)
+    fatal(ext_id, "at least four args expected: source_array, dest_array, from, to");
+  if (nargs > 5)
+    fatal(ext_id, "too many arguments");
+  if (! get_argument(0, AWK_ARRAY, & source_arr_value))
+    fatal(ext_id, "can't retrieve source array");
+  if (! get_argument(1, AWK_ARRAY, & dest_arr_value))
+    fatal(ext_id, "can't retrieve dest array");
+
+  fatal_if_same_array(source_arr_value.array_cookie,
+		      dest_arr_value.array_cookie, "slice");
+
+  if (! get_argument(2, AWK_NUMBER, & from_val))
+    fatal(ext_id, "can't retrieve slice start (3rd arg)");
+  if (! get_argument(3, AWK_NUMBER, & to_val))
+    fatal(ext_id, "can't retrieve slice end (4th arg)");
+  if (nargs > 4) {
+    if (! get_argument(4, AWK_NUMBER, & step_val))
+      fatal(ext_id, "can't retrieve slice step (5th arg)");
+  }
+  if (! (fabs(from_val.num_value) <= _SLICE_MAX_POS
+	 && fabs(to_val.num_value) <= _SLICE_MAX_POS
+	 && (nargs < 5 || fabs(step_val.num_value) <= _SLICE_MAX_POS)))
+    fatal(ext_id, "slice start, end and step must be finite numbers between -2^53 and 2^53");
+  if (nargs > 4) {
+    if (step_val.num_value != trunc(step_val.num_value))
+      fatal(ext_id, "slice step must be a whole number, got <%g>", step_val.num_value);
+    step = (long long) step_val.num_value;
+  }
+  if (step == 0)
+    fatal(ext_id, "slice step can't be zero");
+  from = (long long) from_val.num_value;
+  to = (long long) to_val.num_value;
+
+  if (NULL == (list = alloc_subarray_list(list, maxsize)))
+    fatal(ext_id, "Can't allocate array lists: %s", strerror(errno));
+
+  source_array = source_arr_value.array_cookie;  // *** MANDATORY ***
+  dest_array = dest_arr_value.array_cookie;      // *** MANDATORY ***
+
+  for (pos = from; (step > 0) ? (pos <= to) : (pos >= to); pos += step) {
+    make_number((double) pos, & index_val);
+    if (! get_array_element(source_array, & index_val, AWK_UNDEFINED, & value_val)) {
+      dprint("no element at index <%lld>\n", pos);
+      continue;
+    }
+    make_number(dest_idx, & dest_idx_val);
+    if (value_val.val_type == AWK_ARRAY) {
+      // create the dest subarray now, copy it later
+      dprint("subarray at index <%lld>\n", pos);
+      list = grow_subarray_list(list, size, & maxsize);
+      list[size].dest_array = create_array();
+      list[size].dest_arr_value.val_type = AWK_ARRAY;                   // *** MANDATORY ***
+      list[size].dest_arr_value.array_cookie = list[size].dest_array;   // *** MANDATORY ***
+      if (! set_array_element(dest_array, & dest_idx_val, & list[size].dest_arr_value))
+	fatal(ext_id, "set_array_element() failed on subarray at index <%lld>", pos);
+      list[size].source_array = value_val.array_cookie;
+      list[size].dest_array = list[size].dest_arr_value.array_cookie; // *** MANDATORY -- after set_array_element() ***
+      size += 1;
+    } else {
+      if (! copy_element(value_val, & dest_value_val))
+	fatal(ext_id, "Unknown element at index <%lld> (val_type=%d)",
+	      pos, value_val.val_type);
+      if (! set_array_element(dest_array, & dest_idx_val, & dest_value_val))
+	fatal(ext_id, "set_array_element() failed on value at index <%lld>", pos);
+    }
+    dest_idx += 1;
+  }
+
+  list = _deep_copy(list, & idx, & size, & maxsize);
+  make_number(dest_idx, result);
+
+  // must be called before exit
+  release_subarrays(list, idx, 1, 0);
+  free(list);
+  return result;
+}
+
+
+static awk_value_t*
+do_range(int nargs,
+	 awk_value_t *result,
+	 __attribute__((unused)) struct awk_ext_func *finfo)
+{
+  /*
+   * Fills the $nargs[0] array with the numbers from $nargs[1] up to $nargs[2]
+   * (inclusive, if reached) moving by $nargs[3] (optional, defaults to 1,
+   * may be negative or not integer), *without* deleting elements already
+   * present in it. Infinite or nan arguments are a fatal error.
+   * The array will be indexed with integer values starting from 0.
+   * Exits with a fatal error if there are big issues, returns the number
+   * of added elements.
+   */
+  assert(result != NULL);
+  make_number(0.0, result);
+
+  awk_value_t dest_arr_value;
+  awk_value_t from_val, to_val, step_val;
+  awk_value_t dest_idx_val;
+  awk_value_t dest_value_val;
+  awk_array_t dest_array;
+  double from, to, step = 1, num;
+  size_t dest_idx;
+
+  if (nargs < 3)
+    fatal(ext_id, "at least three args expected: dest_array, from, to");
+  if (nargs > 4)
+    fatal(ext_id, "too many arguments");
+  if (! get_argument(0, AWK_ARRAY, & dest_arr_value))
+    fatal(ext_id, "can't retrieve dest array");
+  if (! get_argument(1, AWK_NUMBER, & from_val))
+    fatal(ext_id, "can't retrieve range start (2nd arg)");
+  if (! get_argument(2, AWK_NUMBER, & to_val))
+    fatal(ext_id, "can't retrieve range end (3rd arg)");
+  if (nargs > 3) {
+    if (! get_argument(3, AWK_NUMBER, & step_val))
+      fatal(ext_id, "can't retrieve range step (4th arg)");
+    step = step_val.num_value;
+  }
+  if (! (isfinite(from_val.num_value) && isfinite(to_val.num_value) && isfinite(step)))
+    fatal(ext_id, "range start, end and step must be finite numbers");
+  if (step == 0)
+    fatal(ext_id, "range step can't be zero");
+  from = from_val.num_value;
+  to = to_val.num_value;
+
+  dest_array = dest_arr_value.array_cookie;  // *** MANDATORY ***
+
+  // computes every item from $from, avoiding accumulation errors with float steps
+  for (dest_idx = 0, num = from;
+       (step > 0) ? (num <= to) : (num >= to);
+       dest_idx++, num = from + step * dest_idx) {
+    make_number(dest_idx, & dest_idx_val);
+    make_number(num, & dest_value_val);
+    if (! set_array_element(dest_array, & dest_idx_val, & dest_value_val))
+      fatal(ext_id, "set_array_element() failed at index <%zu>", dest_idx);
+  }
+
+  make_number(dest_idx, result);
+  return result;
+}
+
+
+/* rough sizes (64-bit gawk builds) used by memsize() */
+#define _MEMSIZE_NODE 72    // a value (or array) NODE
+#define _MEMSIZE_BUCKET 40  // an array's element bucket
+#define _MEMSIZE_TOP 10     // number of the largest subarrays to report
+
+static awk_value_t*
+do_memsize(int nargs,
+	   awk_value_t *result,
+	   __attribute__((unused)) struct awk_ext_func *finfo)
+{
+  /*
+   * Returns an estimate of the bytes held by the $nargs[0] array, counting
+   * elements overhead, indexes and string payloads, and subarrays.
+   * If $nargs[1] (optional) is given, it's cleared and filled with a shape
+   * profile of the $nargs[0] array:
+   *   ["bytes"]       the same estimate returned
+   *   ["arrays"]      the number of arrays (the top array included)
+   *   ["subarrays"], ["scalars"]
+   *   ["numbers"], ["strings"], ["strnums"], ["regexps"], ["undefined"]
+   *                   the number of elements of each kind
+   *   ["numeric_ratio"] numbers / scalars
+   *   ["depth"][L]    the number of elements at level L (1 = top array's)
+   *   ["fanout"][L]   the average number of elements of the arrays
+   *                   holding level L elements...
+   *   ["fanout_max"][L] ...and their maximum
+   *   ["largest"][path] the number of elements of the biggest subarrays,
+   *                   with path being the subarray's indexes joined by SUBSEP.
+   * Exits with a fatal error if there are big issues.
+   */
+  assert(result != NULL);
+  make_number(0.0, result);
+
+  struct subarrays *list = NULL;
+  struct {
+    size_t count;
+    char *path;
+  } top[_MEMSIZE_TOP];
+  awk_value_t dest_arr_value;
+  awk_value_t index_val;
+  awk_value_t value_val;
+  awk_array_t dest_array = NULL;
+  awk_array_t sub_array;
+  awk_flat_array_t *flat;
+  const char *subsep = NULL;
+  size_t subsep_len = 0;
+
+  size_t *depth_elems = NULL;
+  size_t *depth_arrays = NULL;
+  size_t *depth_fanout = NULL;
+  size_t depth_size = 0;
+  size_t arrays = 0, subarrays = 0, numbers = 0, strings = 0;
+  size_t strnums = 0, regexps = 0, undefined = 0;
+  size_t scalars;
+  double bytes = 0;
+  size_t i, d, t, count;
+  size_t idx = 0;
+  size_t size = 0;
+  size_t maxsize = 10;
+
+  if (nargs < 1)
+    fatal(ext_id, "at least one arg expected: array");
+  if (nargs > 2)
+    fatal(ext_id, "too many arguments");
+  if (NULL == (list = alloc_subarray_list(list, maxsize)))
+    fatal(ext_id, "Can't allocate array lists: %s", strerror(errno));
+  if (! get_argument(0, AWK_ARRAY, & list[size].source_arr_value))
+    fatal(ext_id, "can't retrieve source array");
+  if (nargs > 1) {
+    if (! get_argument(1, AWK_ARRAY, & dest_arr_value))
+      fatal(ext_id, "can't retrieve dest array");
+    fatal_if_same_array(list[size].source_arr_value.array_cookie,
+			dest_arr_value.array_cookie, "profile");
+    dest_array = dest_arr_value.array_cookie;  // *** MANDATORY ***
+    subsep = get_subsep(& subsep_len);
+  }
+  for (t = 0; t < _MEMSIZE_TOP; t++) {
+    top[t].count = 0;
+    top[t].path = NULL;
+  }
+
+  list[size].source_array = list[size].source_arr_value.array_cookie;  // *** MANDATORY ***
+  list[size].depth = 0;
+  list[size].path = NULL;
+  size += 1;
+
+  do {
+    d = list[idx].depth;
+    if (d >= depth_size) {
+      depth_size = d + 10;
+      if (NULL == (depth_elems = realloc(depth_elems, sizeof(size_t) * depth_size))
+	  || NULL == (depth_arrays = realloc(depth_arrays, sizeof(size_t) * depth_size))
+	  || NULL == (depth_fanout = realloc(depth_fanout, sizeof(size_t) * depth_size)))
+	fatal(ext_id, "Can't reallocate depth counters: %s", strerror(errno));
+      for (i = d; i < depth_size; i++)
+	depth_elems[i] = depth_arrays[i] = depth_fanout[i] = 0;
+    }
+    arrays += 1;
+    depth_arrays[d] += 1;
+    bytes += _MEMSIZE_NODE;
+
+    if (! flatten_array_typed(list[idx].source_array,
+			      & list[idx].source_flat_array,
+			      AWK_STRING, AWK_UNDEFINED)) {
+      // empty subarray, see NOTE_A
+      list[idx].source_flat_array = NULL;
+      count = 0;
+    } else {
+      count = list[idx].source_flat_array->count;
+    }
+    dprint("list[%zu] depth <%zu> count <%zu>\n", idx, d, count);
+    bytes += count * sizeof(void*);  // the hash table slots
+    depth_elems[d] += count;
+    if (count > depth_fanout[d])
+      depth_fanout[d] = count;
+
+    for (i = 0; i < count; i++) {
+      flat = list[idx].source_flat_array;
+      bytes += _MEMSIZE_BUCKET + _MEMSIZE_NODE + flat->elements[i].index.str_value.len + 1;
+      switch (flat->elements[i].value.val_type) {
+      case AWK_ARRAY:
+	subarrays += 1;
+	list = grow_subarray_list(list, size, & maxsize);
+	list[size].source_array = flat->elements[i].value.array_cookie;
+	list[size].depth = d + 1;
+	list[size].path = (dest_array == NULL) ? NULL
+	  : make_path(list[idx].path, flat->elements[i].index, subsep, subsep_len);
+	size += 1;
+	break;
+      case AWK_STRING:
+	strings += 1;
+	bytes += flat->elements[i].value.str_value.len + 1;
+	break;
+      case AWK_STRNUM:
+	strnums += 1;
+	bytes += flat->elements[i].value.str_value.len + 1;
+	break;
+      case AWK_REGEX:
+	regexps += 1;
+	bytes += flat->elements[i].value.str_value.len + 1;
+	break;
+      case AWK_UNDEFINED:
+	undefined += 1;
+	break;
+      default:  // AWK_NUMBER and, if available, AWK_BOOL
+	numbers += 1;
+	break;
+      }
+    }
+    if (dest_array != NULL && d > 0) {
+      // keep the largest subarrays
+      for (i = 0, t = 1; t < _MEMSIZE_TOP; t++)
+	if (top[t].count < top[i].count)
+	  i = t;
+      if (count > top[i].count) {
+	free(top[i].path);
+	top[i].count = count;
+	top[i].path = list[idx].path;  // moved, not freed below
+	list[idx].path = NULL;
+      }
+    }
+    free(list[idx].path);
+    // not needed anymore, don't keep every level alive until the end
+    if (list[idx].source_flat_array != NULL
+	&& ! release_flattened_array(list[idx].source_array, list[idx].source_flat_array))
+      eprint("release_flattened_array() failed at index <%zu>\n", idx);
+    idx += 1;
+  } while (idx < size);
+
+  make_number(bytes, result);
+
+  if (dest_array != NULL) {
+    scalars = numbers + strings + strnums + regexps + undefined;
+    clear_array(dest_array);
+    set_str_num(dest_array, "bytes", bytes);
+    set_str_num(dest_array, "arrays", arrays);
+    set_str_num(dest_array, "subarrays", subarrays);
+    set_str_num(dest_array, "scalars", scalars);
+    set_str_num(dest_array, "numbers", numbers);
+    set_str_num(dest_array, "strings", strings);
+    set_str_num(dest_array, "strnums", strnums);
+    set_str_num(dest_array, "regexps", regexps);
+    set_str_num(dest_array, "undefined", undefined);
+    set_str_num(dest_array, "numeric_ratio", scalars ? (double) numbers / scalars : 0);
+
+    // elements of the arrays at depth d are at level d+1
+    make_const_string("depth", 5, & index_val);
+    sub_array = set_subarray(dest_array, & index_val);
+    for (d = 0; d < depth_size && depth_arrays[d]; d++) {
+      make_number(d + 1, & index_val);
+      make_number(depth_elems[d], & value_val);
+      if (! set_array_element(sub_array, & index_val, & value_val))
+	fatal(ext_id, "set_array_element() failed on depth <%zu>", d + 1);
+    }
+    make_const_string("fanout", 6, & index_val);
+    sub_array = set_subarray(dest_array, & index_val);
+    for (d = 0; d < depth_size && depth_arrays[d]; d++) {
+      make_number(d + 1, & index_val);
+      make_number((double) depth_elems[d] / depth_arrays[d], & value_val);
+      if (! set_array_element(sub_array, & index_val, & value_val))
+	fatal(ext_id, "set_array_element() failed on fanout <%zu>", d + 1);
+    }
+    make_const_string("fanout_max", 10, & index_val);
+    sub_array = set_subarray(dest_array, & index_val);
+    for (d = 0; d < depth_size && depth_arrays[d]; d++) {
+      make_number(d + 1, & index_val);
+      make_number(depth_fanout[d], & value_val);
+      if (! set_array_element(sub_array, & index_val, & value_val))
+	fatal(ext_id, "set_array_element() failed on fanout_max <%zu>", d + 1);
+    }
+    make_const_string("largest", 7, & index_val);
+    sub_array = set_subarray(dest_array, & index_val);
+    for (t = 0; t < _MEMSIZE_TOP; t++) {
+      if (top[t].path == NULL)
+	continue;
+      set_str_num(sub_array, top[t].path, top[t].count);
+    }
+  }
+
+  // must be called before exit
+  for (t = 0; t < _MEMSIZE_TOP; t++)
+    free(top[t].path);
+  free(depth_elems);
+  free(depth_arrays);
+  free(depth_fanout);
+  free(list);
+  return result;
+}
+
+
+struct sample_item {
+  char *path;         // the dest index (malloc'd)
+  awk_value_t value;  // owned copy of the sampled value
+  double key;         // weighted sampling only
+};
+
+void
+_sample_sift_down(struct sample_item *heap, size_t len, size_t pos)
+{
+  /*
+   * Private function, restores the min-heap (by key) property
+   * of $heap of length $len from $pos downward.
+   */
+  size_t child;
+  struct sample_item tmp;
+  while ((child = 2 * pos + 1) < len) {
+    if (child + 1 < len && heap[child+1].key < heap[child].key)
+      child += 1;
+    if (heap[pos].key <= heap[child].key)
+      break;
+    tmp = heap[pos];
+    heap[pos] = heap[child];
+    heap[child] = tmp;
+    pos = child;
+  }
+}
+
+
+void
+_sample_item_free(struct sample_item *item)
+{
+  /*
+   * Private function, frees the path and the value owned by $item.
+   */
+  free(item->path);
+  item->path = NULL;
+  switch (item->value.val_type) {
+  case AWK_STRING: case AWK_STRNUM: case AWK_REGEX:
+    gawk_free(item->value.str_value.str);
+    break;
+  default:
+    break;
+  }
+}
+
+
+void
+_sample_item_set(struct sample_item *item,
+		 const char *parent,
+		 awk_element_t *element,
+		 double key,
+		 const char *subsep,
+		 size_t subsep_len)
+{
+  /*
+   * Private function, makes $item own a copy of the scalar $element
+   * (having $parent as parent path) and its path, with $key.
+   * Exits with a fatal error if fails.
+   */
+  item->path = make_path(parent, element->index, subsep, subsep_len);
+  if (! copy_element(element->value, & item->value))
+    fatal(ext_id, "Unknown element at index <%s> (val_type=%d)",
+	  item->path, element->value.val_type);
+  item->key = key;
+}
+
+
+struct sample_item*
+_sample_slot(struct sample_item *reservoir, size_t len, size_t *cap, size_t k)
+{
+  /*
+   * Private function, makes room in $reservoir (of capacity $cap)
+   * for the item at $len, growing it up to $k items only as needed,
+   * so a big $k doesn't allocate more than the elements seen.
+   * Returns the (possibly moved) $reservoir, exits with a fatal error if fails.
+   */
+  if (len < *cap)
+    return reservoir;
+  *cap = (*cap == 0) ? 64 : *cap * 2;
+  if (*cap > k)
+    *cap = k;
+  if (NULL == (reservoir = realloc(reservoir, sizeof(struct sample_item) * *cap)))
+    fatal(ext_id, "Can't allocate reservoir: %s", strerror(errno));
+  return reservoir;
+}
+
+
+size_t
+_sample_write(struct sample_item *reservoir,
+	      size_t len,
+	      awk_array_t dest_array)
+{
+  /*
+   * Private function to write the $len sampled elements of $reservoir
+   * in $dest_array, as dest_array[path] = value, handing over
+   * the items' values (paths are freed).
+   * Returns the number of written elements.
+   */
+  size_t i;
+  awk_value_t index_val;
+
+  for (i = 0; i < len; i++) {
+    make_const_string(reservoir[i].path, strlen(reservoir[i].path), & index_val);
+    free(reservoir[i].path);
+    reservoir[i].path = NULL;
+    if (! set_array_element(dest_array, & index_val, & reservoir[i].value))
+      fatal(ext_id, "set_array_element() failed on sampled value <%zu>", i);
+  }
+  return len;
+}
+
+
+static awk_value_t*
+do_sample(int nargs,
+	  awk_value_t *result,
+	  __attribute__((unused)) struct awk_ext_func *finfo)
+{
+  /*
+   * Picks $nargs[2] random scalars from the $nargs[0] array and puts
+   * them in the $nargs[1] array *without* deleting elements already
+   * present in the latter, as dest[path] = value, with path being the
+   * element's indexes joined by SUBSEP (just the index for the elements
+   * of the top array).
+   * $nargs[3] (optional) is the seed (defaults to the current time),
+   * $nargs[4] (optional, defaults to true) if false, don't descend into subarrays.
+   * $nargs[5] (optional) is the sampling kind:
+   *   "u" (the default) uniform sampling;
+   *   "w" weighted sampling, the (numeric) values being the weights,
+   *       elements with weight <= 0 are never picked;
+   *   "s" stratified sampling, picks up to $nargs[2] scalars from each (sub)array.
+   * Sampling is made in a single pass (reservoir sampling) over the
+   * arrays traversal, without copies of the source array: only the
+   * sampled values are copied, and every (sub)array is released
+   * as soon as it has been scanned.
+   * Exits with a fatal error if there are big issues, returns the
+   * number of sampled elements.
+   */
+  assert(result != NULL);
+  make_number(0.0, result);
+
+  struct subarrays *list = NULL;
+  struct sample_item *reservoir = NULL;
+  awk_value_t dest_arr_value;
+  awk_value_t k_val, seed_val, deep_val, how_val;
+  awk_array_t dest_array;
+  awk_flat_array_t *flat;
+  const char *subsep;
+  size_t subsep_len;
+  uint64_t state;
+  char how = 'u';
+  int deep = 1;
+  double weight, key;
+  size_t i, j, k, cap = 0, seen = 0, len = 0, written = 0;
+  size_t idx = 0;
+  size_t size = 0;
+  size_t maxsize = 10;
+
+  if (nargs < 3)
+    fatal(ext_id, "at least three args expected: source_array, dest_array, k");
+  if (nargs > 6)
+    fatal(ext_id, "too many arguments");
+  if (NULL == (list = alloc_subarray_list(list, maxsize)))
+    fatal(ext_id, "Can't allocate array lists: %s", strerror(errno));
+  if (! get_argument(0, AWK_ARRAY, & list[size].source_arr_value))
+    fatal(ext_id, "can't retrieve source array");
+  if (! get_argument(1, AWK_ARRAY, & dest_arr_value))
+    fatal(ext_id, "can't retrieve dest array");
+
+  fatal_if_same_array(list[size].source_arr_value.array_cookie,
+		      dest_arr_value.array_cookie, "sample");
+
+  if (! get_argument(2, AWK_NUMBER, & k_val))
+    fatal(ext_id, "can't retrieve sample size (3rd arg)");
+  if (! (k_val.num_value >= 0 && isfinite(k_val.num_value)))
+    fatal(ext_id, "Invalid sample size: <%g>", k_val.num_value);
+  // more than any array can hold, anyway
+  k = (k_val.num_value < 1e18) ? (size_t) k_val.num_value : (size_t) 1e18;
+  if (nargs > 3) {
+    if (! get_argument(3, AWK_NUMBER, & seed_val))
+      fatal(ext_id, "can't retrieve seed (4th arg)");
+    state = rand_seed(seed_val.num_value);
+  } else {
+    state = rand_seed((double) time(NULL));
+  }
+  if (nargs > 4) {
+    if (! get_argument(4, AWK_NUMBER, & deep_val))
+      fatal(ext_id, "can't retrieve deep flag (5th arg)");
+    deep = (deep_val.num_value != 0);
+  }
+  if (nargs > 5) {
+    if (! get_argument(5, AWK_STRING, & how_val))
+      fatal(ext_id, "can't retrieve sample() string choice (u|w|s)");
+    if (how_val.str_value.len != 1
+	|| NULL == strchr("uws", how_val.str_value.str[0]))
+      fatal(ext_id,
+	    "Invalid sample() string choice (u|w|s): <%s>",
+	    how_val.str_value.str);
+    how = how_val.str_value.str[0];
+  }
+  if (k == 0)
+    goto out;
+
+  dest_array = dest_arr_value.array_cookie;                            // *** MANDATORY ***
+  subsep = get_subsep(& subsep_len);
+  list[size].source_array = list[size].source_arr_value.array_cookie;  // *** MANDATORY ***
+  list[size].path = NULL;
+  size += 1;
+
+  do {
+    if (! flatten_array_typed(list[idx].source_array,
+			      & list[idx].source_flat_array,
+			      AWK_STRING, AWK_UNDEFINED)) {
+      // skip, see NOTE_A
+      list[idx].source_flat_array = NULL;
+      free(list[idx].path);
+      list[idx].path = NULL;
+      idx += 1;
+      continue;
+    }
+    flat = list[idx].source_flat_array;
+    if (how == 's')
+      seen = len = 0;  // a new stratum
+
+    for (i = 0; i < flat->count; i++) {
+      if (flat->elements[i].value.val_type == AWK_ARRAY) {
+	if (deep) {
+	  list = grow_subarray_list(list, size, & maxsize);
+	  list[size].source_array = flat->elements[i].value.array_cookie;
+	  list[size].path = make_path(list[idx].path, flat->elements[i].index,
+				      subsep, subsep_len);
+	  size += 1;
+	}
+	continue;
+      }
+      if (how == 'w') {
+	// Efraimidis-Spirakis: keeps the k biggest u^(1/w), here as log(u)/w
+	value_to_number(flat->elements[i].value, & weight);
+	if (! (weight > 0))
+	  continue;
+	key = log(rand_unit(& state)) / weight;
+	if (len < k) {
+	  reservoir = _sample_slot(reservoir, len, & cap, k);
+	  _sample_item_set(& reservoir[len++], list[idx].path, & flat->elements[i],
+			   key, subsep, subsep_len);
+	  if (len == k)  // heapify
+	    for (j = k / 2; j-- > 0; )
+	      _sample_sift_down(reservoir, len, j);
+	} else if (key > reservoir[0].key) {
+	  _sample_item_free(& reservoir[0]);
+	  _sample_item_set(& reservoir[0], list[idx].path, & flat->elements[i],
+			   key, subsep, subsep_len);
+	  _sample_sift_down(reservoir, len, 0);
+	}
+      } else {
+	// algorithm R
+	if (seen < k) {
+	  reservoir = _sample_slot(reservoir, len, & cap, k);
+	  _sample_item_set(& reservoir[len++], list[idx].path, & flat->elements[i],
+			   0, subsep, subsep_len);
+	} else {
+	  j = rand_next(& state) % (seen + 1);
+	  if (j < k) {
+	    _sample_item_free(& reservoir[j]);
+	    _sample_item_set(& reservoir[j], list[idx].path, & flat->elements[i],
+			     0, subsep, subsep_len);
+	  }
+	}
+	seen += 1;
+      }
+    }
+    if (how == 's')
+      written += _sample_write(reservoir, len, dest_array);
+
+    // sampled values are owned by the reservoir, the level can go
+    if (! release_flattened_array(list[idx].source_array, flat))
+      eprint("release_flattened_array() failed at index <%zu>\n", idx);
+    free(list[idx].path);
+    list[idx].path = NULL;
+    idx += 1;
+  } while (idx < size);
+
+  if (how != 's')
+    written = _sample_write(reservoir, len, dest_array);
+  make_number(written, result);
+
+ out:
+  free(reservoir);
+  free(list);
+  return result;
+}
+
+
+static awk_value_t*
+do_transpose(int nargs,
+	     awk_value_t *result,
+	     __attribute__((unused)) struct awk_ext_func *finfo)
+{
+  /*
+   * Transposes the two-level $nargs[0] array into the $nargs[1] array
+   * *without* deleting elements already present in the latter,
+   * so that dest[col][row] = src[row][col].
+   * An existing dest[col] subarray is reused (only its dest[col][row]
+   * elements are overwritten), a scalar dest[col] is a fatal error.
+   * Each row is flattened only once and each dest column is looked up
+   * only once; deeper subarrays (src[row][col][...]) are copied whole.
+   * Exits with a fatal error if there are big issues, returns false if
+   * everything is not exactly ok (e.g. src has scalar rows, which are
+   * skipped) but overall there are no errors respecting the requested
+   * operations, true if everything is fine.
+   */
+  assert(result != NULL);
+  make_number(0.0, result);
+
+  struct subarrays *list = NULL;
+  struct strmap cols;
+  awk_value_t source_arr_value;
+  awk_value_t dest_arr_value;
+  awk_value_t index_val;
+  awk_value_t value_val;
+  awk_array_t dest_array;
+  awk_array_t *col_arrays = NULL;
+  awk_flat_array_t *rows;
+  awk_flat_array_t *row;
+  awk_element_t *cell;
+  size_t *col_slot;
+  size_t col_arrays_size = 0;
+  size_t r, c;
+  int found;
+  int all_ok = 1;
+  size_t idx = 0;
+  size_t size = 0;
+  size_t maxsize = 10;
+
+  if (nargs != 2)
+    fatal(ext_id, "two args expected: source_array, dest_array");
+  if (! get_argument(0, AWK_ARRAY, & source_arr_value))
+    fatal(ext_id, "can't retrieve source array");
+  if (! get_argument(1, AWK_ARRAY, & dest_arr_value))
+    fatal(ext_id, "can't retrieve dest array");
+
+  fatal_if_same_array(source_arr_value.array_cookie,
+		      dest_arr_value.array_cookie, "transpose");
+
+  dest_array = dest_arr_value.array_cookie;  // *** MANDATORY ***
+
+  if (! flatten_array_typed(source_arr_value.array_cookie, & rows,
+			    AWK_STRING, AWK_UNDEFINED)) {
+    dprint("could not flatten source array\n");  // empty, see NOTE_A
+    return result;
+  }
+  if (NULL == (list = alloc_subarray_list(list, maxsize)))
+    fatal(ext_id, "Can't allocate array lists: %s", strerror(errno));
+  strmap_init(& cols, 16);
+
+  for (r = 0; r < rows->count; r++) {
+    if (rows->elements[r].value.val_type != AWK_ARRAY) {
+      dprint("skip scalar row at index <%zu>\n", r);
+      all_ok = 0;
+      continue;
+    }
+    if (! flatten_array_typed(rows->elements[r].value.array_cookie, & row,
+			      AWK_STRING, AWK_UNDEFINED))
+      continue;  // empty row, see NOTE_A
+
+    for (c = 0; c < row->count; c++) {
+      cell = & row->elements[c];
+      col_slot = strmap_get(& cols, cell->index.str_value.str,
+			    cell->index.str_value.len, & found);
+      if (! found) {
+	// a new column
+	if (cols.count > col_arrays_size) {
+	  col_arrays_size = cols.count * 2;
+	  if (NULL == (col_arrays = realloc(col_arrays, sizeof(awk_array_t) * col_arrays_size)))
+	    fatal(ext_id, "Can't reallocate columns: %s", strerror(errno));
+	}
+	*col_slot = cols.count - 1;
+	make_const_string(cell->index.str_value.str, cell->index.str_value.len, & index_val);
+	if (! get_array_element(dest_array, & index_val, AWK_UNDEFINED, & value_val))
+	  col_arrays[*col_slot] = set_subarray(dest_array, & index_val);
+	else if (value_val.val_type == AWK_ARRAY)
+	  col_arrays[*col_slot] = value_val.array_cookie;
+	else
+	  fatal(ext_id, "dest element <%s> is a scalar, can't transpose into it",
+		cell->index.str_value.str);
+      }
+      make_const_string(rows->elements[r].index.str_value.str,
+			rows->elements[r].index.str_value.len, & index_val);
+      if (cell->value.val_type == AWK_ARRAY) {
+	// copy it later
+	list = grow_subarray_list(list, size, & maxsize);
+	list[size].source_array = cell->value.array_cookie;
+	list[size].dest_array = set_subarray(col_arrays[*col_slot], & index_val);
+	size += 1;
+      } else {
+	if (! copy_element(cell->value, & value_val))
+	  fatal(ext_id, "Unknown element at row <%zu> col <%zu> (val_type=%d)",
+		r, c, cell->value.val_type);
+	if (! set_array_element(col_arrays[*col_slot], & index_val, & value_val))
+	  fatal(ext_id, "set_array_element() failed at row <%zu> col <%zu>", r, c);
+      }
+    }
+    if (! release_flattened_array(rows->elements[r].value.array_cookie, row))
+      all_ok = 0;
+  }
+
+  list = _deep_copy(list, & idx, & size, & maxsize);
+  make_number(all_ok, result);
+
+  // must be called before exit
+  if (! release_subarrays(list, idx, 1, 0))
+    make_number(0.0, result);
+  if (! release_flattened_array(source_arr_value.array_cookie, rows))
+    make_number(0.0, result);
+  strmap_free(& cols);
+  free(col_arrays);
+  free(list);
+  return result;
+}
+
+
+struct pivot_slot {
+  double sum;
+  double min;
+  double max;
+  size_t count;
+  size_t nums;  // numeric cells, the only ones in sum, min and max
+  awk_value_t first;
+};
+
+static awk_value_t*
+do_pivot(int nargs,
+	 awk_value_t *result,
+	 __attribute__((unused)) struct awk_ext_func *finfo)
+{
+  /*
+   * Aggregates the columns of the two-level $nargs[0] array (src[row][col])
+   * into the $nargs[1] array, *without* deleting elements already present
+   * in the latter, as dest[col] = agg(src[*][col]).
+   * $nargs[2] is the aggregation, one of:
+   *   "sum", "min", "max" (of the numeric cells, the others are skipped;
+   *   a column without numeric cells is 0 for sum and not set otherwise)
+   *   "count" (of the cells)
+   *   "first" (the value of the first row having that col, by index
+   *   order as @ind_num_asc: numeric indexes first).
+   * Each row is flattened only once and values are aggregated in native
+   * buffers, dest is written once per column at the end.
+   * Scalar rows, deeper subarrays (src[row][col][...]) and, for
+   * "sum", "min" and "max", non-numeric cells are skipped.
+   * Exits with a fatal error if there are big issues, returns false if
+   * everything is not exactly ok (e.g. something was skipped)
+   * but overall there are no errors respecting the requested operations,
+   * true if everything is fine.
+   */
+  assert(result != NULL);
+  make_number(0.0, result);
+
+  struct strmap cols;
+  struct pivot_slot *slots = NULL;
+  struct pivot_slot *slot;
+  awk_value_t source_arr_value;
+  awk_value_t dest_arr_value;
+  awk_value_t agg_val;
+  awk_value_t index_val;
+  awk_value_t value_val;
+  awk_array_t dest_array;
+  awk_flat_array_t *rows;
+  awk_flat_array_t *row;
+  awk_element_t **sorted_rows;
+  awk_element_t *cell;
+  size_t *col_slot;
+  size_t slots_size = 0;
+  size_t r, c;
+  double num;
+  int found, numeric;
+  int all_ok = 1;
+  enum { AGG_SUM, AGG_COUNT, AGG_MIN, AGG_MAX, AGG_FIRST } agg;
+
+  if (nargs != 3)
+    fatal(ext_id, "three args expected: source_array, dest_array, agg");
+  if (! get_argument(0, AWK_ARRAY, & source_arr_value))
+    fatal(ext_id, "can't retrieve source array");
+  if (! get_argument(1, AWK_ARRAY, & dest_arr_value))
+    fatal(ext_id, "can't retrieve dest array");
+
+  fatal_if_same_array(source_arr_value.array_cookie,
+		      dest_arr_value.array_cookie, "pivot");
+
+  if (! get_argument(2, AWK_STRING, & agg_val))
+    fatal(ext_id, "can't retrieve pivot() aggregation (sum|count|min|max|first)");
+  if (! strcmp(agg_val.str_value.str, "sum"))
+    agg = AGG_SUM;
+  else if (! strcmp(agg_val.str_value.str, "count"))
+    agg = AGG_COUNT;
+  else if (! strcmp(agg_val.str_value.str, "min"))
+    agg = AGG_MIN;
+  else if (! strcmp(agg_val.str_value.str, "max"))
+    agg = AGG_MAX;
+  else if (! strcmp(agg_val.str_value.str, "first"))
+    agg = AGG_FIRST;
+  else
+    fatal(ext_id,
+	  "Invalid pivot() aggregation (sum|count|min|max|first): <%s>",
+	  agg_val.str_value.str);
+
+  dest_array = dest_arr_value.array_cookie;  // *** MANDATORY ***
+
+  if (! flatten_array_typed(source_arr_value.array_cookie, & rows,
+			    AWK_STRING, AWK_UNDEFINED)) {
+    dprint("could not flatten source array\n");  // empty, see NOTE_A
+    return result;
+  }
+  strmap_init(& cols, 16);
+  // rows by index order, for "first"
+  sorted_rows = sort_flat_by_index(rows);
+
+  for (r = 0; r < rows->count; r++) {
+    if (sorted_rows[r]->value.val_type != AWK_ARRAY) {
+      dprint("skip scalar row at index <%zu>\n", r);
+      all_ok = 0;
+      continue;
+    }
+    if (! flatten_array_typed(sorted_rows[r]->value.array_cookie, & row,
+			      AWK_STRING, AWK_UNDEFINED))
+      continue;  // empty row, see NOTE_A
+
+    for (c = 0; c < row->count; c++) {
+      cell = & row->elements[c];
+      if (cell->value.val_type == AWK_ARRAY) {
+	all_ok = 0;
+	continue;
+      }
+      col_slot = strmap_get(& cols, cell->index.str_value.str,
+			    cell->index.str_value.len, & found);
+      numeric = value_to_number(cell->value, & num);
+      if (! found) {
+	// a new column
+	if (cols.count > slots_size) {
+	  slots_size = cols.count * 2;
+	  if (NULL == (slots = realloc(slots, sizeof(struct pivot_slot) * slots_size)))
+	    fatal(ext_id, "Can't reallocate columns: %s", strerror(errno));
+	}
+	*col_slot = cols.count - 1;
+	slot = & slots[*col_slot];
+	slot->sum = slot->min = slot->max = 0;
+	slot->count = slot->nums = 0;
+	if (agg == AGG_FIRST && ! copy_element(cell->value, & slot->first))
+	  fatal(ext_id, "Unknown element at row <%zu> col <%zu> (val_type=%d)",
+		r, c, cell->value.val_type);
+      }
+      slot = & slots[*col_slot];
+      slot->count += 1;
+      if (! numeric) {
+	if (agg == AGG_SUM || agg == AGG_MIN || agg == AGG_MAX) {
+	  dprint("skip non-numeric cell at row <%zu> col <%zu>\n", r, c);
+	  all_ok = 0;
+	}
+	continue;
+      }
+      slot->sum += num;
+      if (slot->nums == 0 || num < slot->min)
+	slot->min = num;
+      if (slot->nums == 0 || num > slot->max)
+	slot->max = num;
+      slot->nums += 1;
+    }
+    if (! release_flattened_array(sorted_rows[r]->value.array_cookie, row))
+      all_ok = 0;
+  }
+
+  // write the columns
+  for (c = 0; c < cols.size; c++) {
+    if (cols.items[c].key == NULL)
+      continue;
+    slot = & slots[cols.items[c].value];
+    if ((agg == AGG_MIN || agg == AGG_MAX) && slot->nums == 0)
+      continue;  // no numeric cells
+    switch (agg) {
+    case AGG_SUM:   make_number(slot->sum, & value_val); break;
+    case AGG_COUNT: make_number(slot->count, & value_val); break;
+    case AGG_MIN:   make_number(slot->min, & value_val); break;
+    case AGG_MAX:   make_number(slot->max, & value_val); break;
+    case AGG_FIRST: value_val = slot->first; break;
+    }
+    make_const_string(cols.items[c].key, cols.items[c].len, & index_val);
+    if (! set_array_element(dest_array, & index_val, & value_val))
+      fatal(ext_id, "set_array_element() failed on column <%s>", cols.items[c].key);
+  }
+  make_number(all_ok, result);
+
+  // must be called before exit
+  if (! release_flattened_array(source_arr_value.array_cookie, rows))
+    make_number(0.0, result);
+  strmap_free(& cols);
+  free(sorted_rows);
+  free(slots);
+  return result;
+}
+
+
+struct merge_cursor {
+  awk_array_t array;
+  size_t nth;          // the array's argument position
+  double pos;          // current index
+  double end;          // last index + 1
+  awk_value_t value;   // current value
+  awk_value_t key;     // current value, as used for comparisons
+};
+
+int
+_merge_compare(struct merge_cursor *c1, struct merge_cursor *c2, int numeric)
+{
+  /*
+   * Private function for merge_sorted(), compares the current
+   * keys of the $c1 and $c2 cursors (numerically if $numeric)
+   * returning <0, 0 or >0 like strcmp().
+   */
+  int cmp;
+  if (numeric)
+    return (c1->key.num_value > c2->key.num_value)
+      - (c1->key.num_value < c2->key.num_value);
+  cmp = memcmp(c1->key.str_value.str, c2->key.str_value.str,
+	       (c1->key.str_value.len < c2->key.str_value.len)
+	       ? c1->key.str_value.len : c2->key.str_value.len);
+  if (cmp == 0)
+    cmp = (c1->key.str_value.len > c2->key.str_value.len)
+      - (c1->key.str_value.len < c2->key.str_value.len);
+  return cmp;
+}
+
+
+int
+_merge_next(struct merge_cursor *cur, int numeric)
+{
+  /*
+   * Private function for merge_sorted(), moves $cur to its
+   * next scalar value, skipping subarrays.
+   * Returns 1 if succedes, 0 if the array is exhausted.
+   * Exits with a fatal error if an index is missing, since then
+   * the array isn't indexed with consecutive integers.
+   */
+  awk_value_t index_val;
+  for (; cur->pos < cur->end; cur->pos += 1) {
+    make_number(cur->pos, & index_val);
+    if (! get_array_element(cur->array, & index_val, AWK_UNDEFINED, & cur->value))
+      fatal(ext_id, "missing index <%g> in array (arg %zu): "
+	    "indexes must be consecutive integers", cur->pos, cur->nth + 1);
+    if (cur->value.val_type == AWK_ARRAY) {
+      dprint("skip subarray at index <%g> (arg %zu)\n", cur->pos, cur->nth);
+      continue;
+    }
+    if (numeric) {
+      make_number(0, & cur->key);
+      value_to_number(cur->value, & cur->key.num_value);
+    } else if (cur->value.val_type == AWK_STRING
+	       || cur->value.val_type == AWK_STRNUM
+	       || cur->value.val_type == AWK_REGEX) {
+      cur->key = cur->value;
+    } else if (! get_array_element(cur->array, & index_val, AWK_STRING, & cur->key)) {
+      continue;
+    }
+    cur->pos += 1;
+    return 1;
+  }
+  return 0;
+}
+
+
+void
+_merge_sift_down(struct merge_cursor **heap, size_t len, size_t pos, int numeric)
+{
+  /*
+   * Private function for merge_sorted(), restores the min-heap
+   * property of $heap of length $len from $pos downward.
+   * Ties are resolved by argument position, for a stable merge.
+   */
+  size_t child;
+  struct merge_cursor *tmp;
+  int cmp;
+  while ((child = 2 * pos + 1) < len) {
+    if (child + 1 < len) {
+      cmp = _merge_compare(heap[child+1], heap[child], numeric);
+      if (cmp < 0 || (cmp == 0 && heap[child+1]->nth < heap[child]->nth))
+	child += 1;
+    }
+    cmp = _merge_compare(heap[pos], heap[child], numeric);
+    if (cmp < 0 || (cmp == 0 && heap[pos]->nth < heap[child]->nth))
+      break;
+    tmp = heap[pos];
+    heap[pos] = heap[child];
+    heap[child] = tmp;
+    pos = child;
+  }
+}
+
+
+static awk_value_t*
+do_merge_sorted(int nargs,
+		awk_value_t *result,
+		__attribute__((unused)) struct awk_ext_func *finfo)
+{
+  /*
+   * Merges the (already sorted) arrays from $nargs[2] onward into
+   * the $nargs[0] array *without* deleting elements already present
+   * in the latter, in O(n log k) for k arrays.
+   * Input arrays must be indexed with consecutive integers, starting
+   * from 1 (as asort() does) or 0 (as deep_flat() does), a fatal
+   * error otherwise; subarrays are skipped.
+   * $nargs[1] is the merge mode, a string of:
+   *   "n" numeric or "s" string comparison (one of the two is mandatory)
+   *   "u" (optional) removes duplicates.
+   * The merged array will be indexed with integer values starting from 0.
+   * Exits with a fatal error if there are big issues, returns the
+   * number of merged elements.
+   */
+  assert(result != NULL);
+  make_number(0.0, result);
+
+  struct merge_cursor *cursors = NULL;
+  struct merge_cursor **heap = NULL;
+  struct merge_cursor last;
+  awk_value_t dest_arr_value;
+  awk_value_t mode_val;
+  awk_value_t arr_value;
+  awk_value_t index_val;
+  awk_value_t value_val;
+  awk_array_t dest_array;
+  size_t i, count, len = 0;
+  size_t dest_idx = 0;
+  int numeric = -1, uniq = 0, has_last = 0;
+
+  if (nargs < 3)
+    fatal(ext_id, "at least three args expected: dest_array, mode, array [, array...]");
+  if (! get_argument(0, AWK_ARRAY, & dest_arr_value))
+    fatal(ext_id, "can't retrieve dest array");
+  if (! get_argument(1, AWK_STRING, & mode_val))
+    fatal(ext_id, "can't retrieve merge_sorted() mode (n|s[u])");
+  for (i = 0; i < mode_val.str_value.len; i++) {
+    switch (mode_val.str_value.str[i]) {
+    case 'n':
+      if (numeric == 0)
+	fatal(ext_id, "Invalid merge_sorted() mode (n|s[u]): <%s>", mode_val.str_value.str);
+      numeric = 1; break;
+    case 's':
+      if (numeric == 1)
+	fatal(ext_id, "Invalid merge_sorted() mode (n|s[u]): <%s>", mode_val.str_value.str);
+      numeric = 0; break;
+    case 'u':
+      uniq = 1; break;
+    default:
+      fatal(ext_id, "Invalid merge_sorted() mode (n|s[u]): <%s>", mode_val.str_value.str);
+    }
+  }
+  if (numeric < 0)
+    fatal(ext_id, "Invalid merge_sorted() mode (n|s[u]): <%s>", mode_val.str_value.str);
+
+  dest_array = dest_arr_value.array_cookie;  // *** MANDATORY ***
+
+  if (NULL == (cursors = malloc(sizeof(struct merge_cursor) * nargs))
+      || NULL == (heap = malloc(sizeof(struct merge_cursor *) * nargs)))
+    fatal(ext_id, "Can't allocate merge cursors: %s", strerror(errno));
+
+  for (i = 2; i < (size_t) nargs; i++) {
+    if (! get_argument(i, AWK_ARRAY, & arr_value))
+      fatal(ext_id, "can't retrieve array (arg %zu)", i + 1);
+    fatal_if_same_array(arr_value.array_cookie, dest_array, "merge");
+    if (! get_element_count(arr_value.array_cookie, & count))
+      fatal(ext_id, "can't get elements count (arg %zu)", i + 1);
+    cursors[len].array = arr_value.array_cookie;
+    cursors[len].nth = i;
+    make_number(0, & index_val);
+    cursors[len].pos = get_array_element(cursors[len].array, & index_val,
+					 AWK_UNDEFINED, & value_val) ? 0 : 1;
+    cursors[len].end = cursors[len].pos + count;
+    if (_merge_next(& cursors[len], numeric)) {
+      heap[len] = & cursors[len];
+      len += 1;
+    }
+  }
+  for (i = len / 2; i-- > 0; )
+    _merge_sift_down(heap, len, i, numeric);
+
+  while (len > 0) {
+    if (! (uniq && has_last && _merge_compare(& last, heap[0], numeric) == 0)) {
+      last.key = heap[0]->key;
+      has_last = 1;
+      if (! copy_element(heap[0]->value, & value_val))
+	fatal(ext_id, "Unknown element (val_type=%d)", heap[0]->value.val_type);
+      make_number(dest_idx, & index_val);
+      if (! set_array_element(dest_array, & index_val, & value_val))
+	fatal(ext_id, "set_array_element() failed at index <%zu>", dest_idx);
+      dest_idx += 1;
+    }
+    if (! _merge_next(heap[0], numeric))
+      heap[0] = heap[--len];  // exhausted
+    _merge_sift_down(heap, len, 0, numeric);
+  }
+
+  make_number(dest_idx, result);
+  free(heap);
+  free(cursors);
+  return result;
+}
+
+
+static awk_value_t*
+do_grep(int nargs,
+	awk_value_t *result,
+	__attribute__((unused)) struct awk_ext_func *finfo)
+{
+  /*
+   * Copies in the $nargs[1] array the elements of the $nargs[0] array
+   * matching the regex $nargs[2] (a string or a regex constant),
+   * *without* deleting elements already present in the latter.
+   * $nargs[3] (optional) is either "i" (matches indexes) or "v" (matches
+   * values, the default), optionally followed by "p": the regex is then
+   * a PCRE2 one (needs the extension compiled with HAVE_PCRE2), otherwise
+   * it's an extended POSIX one, as awk's, whatever the build.
+   * $nargs[4] (optional) if true, copies the elements *not* matching.
+   * $nargs[5] (optional) if true, descends into subarrays and sets
+   * dest[path] = value, with path being the element's indexes joined
+   * by SUBSEP. Otherwise only the top array is filtered, and when
+   * matching indexes subarrays are copied whole (on values,
+   * they are skipped).
+   * Compiled regexes are cached, so repeated calls with the same
+   * pattern don't compile it again.
+   * Exits with a fatal error if there are big issues, returns the
+   * number of copied elements.
+   */
+  assert(result != NULL);
+  make_number(0.0, result);
+
+  struct subarrays *list = NULL;
+  struct regex_cache_item *regex;
+  awk_value_t dest_arr_value;
+  awk_value_t regex_val, what, invert_val, deep_val;
+  awk_value_t index_val;
+  awk_value_t value_val;
+  awk_array_t dest_array;
+  awk_flat_array_t *flat;
+  const char *subsep = NULL;
+  const char *convfmt;
+  const char *str;
+  char buf[64];
+  char *path;
+  size_t subsep_len = 0, len;
+  int on_vals = 1, invert = 0, deep = 0, pcre = 0;
+  size_t i, copied = 0;
+  size_t idx = 0;
+  size_t size = 0;
+  size_t maxsize = 10;
+  size_t copy_idx = 0;
+  size_t copy_size = 0;
+  size_t copy_maxsize = 10;
+  struct subarrays *copy_list = NULL;
+
+  if (nargs < 3)
+    fatal(ext_id, "at least three args expected: source_array, dest_array, regex");
+  if (nargs > 6)
+    fatal(ext_id, "too many arguments");
+  if (NULL == (list = alloc_subarray_list(list, maxsize))
+      || NULL == (copy_list = alloc_subarray_list(copy_list, copy_maxsize)))
+    fatal(ext_id, "Can't allocate array lists: %s", strerror(errno));
+  if (! get_argument(0, AWK_ARRAY, & list[size].source_arr_value))
+    fatal(ext_id, "can't retrieve source array");
+  if (! get_argument(1, AWK_ARRAY, & dest_arr_value))
+    fatal(ext_id, "can't retrieve dest array");
+
+  fatal_if_same_array(list[size].source_arr_value.array_cookie,
+		      dest_arr_value.array_cookie, "grep()");
+
+  if (! get_argument(2, AWK_UNDEFINED, & regex_val))
+    fatal(ext_id, "can't retrieve regex (3rd arg)");
+  if (! (regex_val.val_type == AWK_STRING
+	 || regex_val.val_type == AWK_REGEX
+	 || regex_val.val_type == AWK_STRNUM))
+    fatal(ext_id, "regex (3rd arg) must be a string or a regex, got <%s>",
+	  _val_types[regex_val.val_type]);
+  if (nargs > 3) {
+    if (! get_argument(3, AWK_STRING, & what))
+      fatal(ext_id, "can't retrieve grep() string choice (i|v[p])");
+    if (what.str_value.len < 1 || what.str_value.len > 2
+	|| (what.str_value.len == 2 && what.str_value.str[1] != 'p'))
+      fatal(ext_id, "Invalid grep() string choice (i|v[p]): <%s>", what.str_value.str);
+    switch (what.str_value.str[0]) {
+    case 'i':
+      on_vals = 0; break;
+    case 'v':
+      on_vals = 1; break;
+    default:
+      fatal(ext_id, "Invalid grep() string choice (i|v[p]): <%s>", what.str_value.str);
+    }
+    pcre = (what.str_value.len == 2);
+  }
+  if (nargs > 4) {
+    if (! get_argument(4, AWK_NUMBER, & invert_val))
+      fatal(ext_id, "can't retrieve invert flag (5th arg)");
+    invert = (invert_val.num_value != 0);
+  }
+  if (nargs > 5) {
+    if (! get_argument(5, AWK_NUMBER, & deep_val))
+      fatal(ext_id, "can't retrieve deep flag (6th arg)");
+    deep = (deep_val.num_value != 0);
+  }
+
+  regex = get_regex(regex_val.str_value.str, regex_val.str_value.len, pcre);
+  convfmt = get_convfmt();
+  if (deep)
+    subsep = get_subsep(& subsep_len);
+
+  dest_array = dest_arr_value.array_cookie;                            // *** MANDATORY ***
+  list[size].source_array = list[size].source_arr_value.array_cookie;  // *** MANDATORY ***
+  list[size].path = NULL;
+  size += 1;
+
+  do {
+    if (! flatten_array_typed(list[idx].source_array,
+			      & list[idx].source_flat_array,
+			      AWK_STRING, AWK_UNDEFINED)) {
+      // skip, see NOTE_A
+      list[idx].source_flat_array = NULL;
+      idx += 1;
+      continue;
+    }
+    flat = list[idx].source_flat_array;
+
+    for (i = 0; i < flat->count; i++) {
+      if (flat->elements[i].value.val_type == AWK_ARRAY) {
+	if (deep) {
+	  list = grow_subarray_list(list, size, & maxsize);
+	  list[size].source_array = flat->elements[i].value.array_cookie;
+	  list[size].path = make_path(list[idx].path, flat->elements[i].index,
+				      subsep, subsep_len);
+	  size += 1;
+	  continue;
+	}
+	if (on_vals)
+	  continue;
+      }
+      if (on_vals)
+	str = scalar_to_str(flat->elements[i].value, buf, sizeof(buf), convfmt, & len);
+      else
+	str = scalar_to_str(flat->elements[i].index, buf, sizeof(buf), convfmt, & len);
+      if (regex_match(regex, str, len) == invert)
+	continue;
+
+      if (deep) {
+	path = make_path(list[idx].path, flat->elements[i].index, subsep, subsep_len);
+	make_const_string(path, strlen(path), & index_val);
+	free(path);
+      } else {
+	make_const_string(flat->elements[i].index.str_value.str,
+			  flat->elements[i].index.str_value.len, & index_val);
+      }
+      if (flat->elements[i].value.val_type == AWK_ARRAY) {
+	// copy it later
+	copy_list = grow_subarray_list(copy_list, copy_size, & copy_maxsize);
+	copy_list[copy_size].source_array = flat->elements[i].value.array_cookie;
+	copy_list[copy_size].dest_array = set_subarray(dest_array, & index_val);
+	copy_size += 1;
+      } else {
+	if (! copy_element(flat->elements[i].value, & value_val))
+	  fatal(ext_id, "Unknown element at index <%zu> (val_type=%d)",
+		i, flat->elements[i].value.val_type);
+	if (! set_array_element(dest_array, & index_val, & value_val))
+	  fatal(ext_id, "set_array_element() failed on value at index <%zu>", i);
+      }
+      copied += 1;
+    }
+    idx += 1;
+  } while (idx < size);
+
+  copy_list = _deep_copy(copy_list, & copy_idx, & copy_size, & copy_maxsize);
+  make_number(copied, result);
+
+  // must be called before exit
+  release_subarrays(copy_list, copy_idx, 1, 0);
+  release_subarrays(list, idx, 1, 0);
+  for (i = 0; i < size; i++)
+    free(list[i].path);
+  free(copy_list);
+  free(list);
+  return result;
+}
+
+
+enum pipe_kind { PIPE_FLAT, PIPE_FLAT_IDX, PIPE_UNIQ, PIPE_SORT, PIPE_HEAD, PIPE_TAIL };
+
+struct pipe_stage {
+  enum pipe_kind kind;
+  int numeric;   // sort only
+  int desc;      // sort only
+  size_t n;      // head and tail only
+  struct strmap seen;  // uniq only, when streamed
+};
+
+struct pipe_item {
+  awk_value_t value;
+  double num;        // value as number, for numeric sorts
+  const char *str;   // value as string, for uniq and string sorts...
+  size_t off;        // ...or its offset in the keys pool, while that grows
+  size_t len;        // str length
+  size_t seq;        // snapshot position, for stable sorts
+};
+
+int
+_pipe_cmp_num(const void *a, const void *b)
+{
+  /* Private qsort() function for pipeline(), numeric ascending. */
+  const struct pipe_item *i1 = a, *i2 = b;
+  if (i1->num != i2->num)
+    return (i1->num > i2->num) - (i1->num < i2->num);
+  return (i1->seq > i2->seq) - (i1->seq < i2->seq);
+}
+
+int
+_pipe_cmp_num_desc(const void *a, const void *b)
+{
+  /* Private qsort() function for pipeline(), numeric descending. */
+  const struct pipe_item *i1 = a, *i2 = b;
+  if (i1->num != i2->num)
+    return (i1->num < i2->num) - (i1->num > i2->num);
+  return (i1->seq > i2->seq) - (i1->seq < i2->seq);
+}
+
+int
+_pipe_strcmp(const struct pipe_item *i1, const struct pipe_item *i2)
+{
+  /* Private function for pipeline(), compares the string values. */
+  int cmp;
+  if ((cmp = memcmp(i1->str, i2->str, i1->len < i2->len ? i1->len : i2->len)) == 0)
+    cmp = (i1->len > i2->len) - (i1->len < i2->len);
+  return cmp;
+}
+
+int
+_pipe_cmp_str(const void *a, const void *b)
+{
+  /* Private qsort() function for pipeline(), string ascending. */
+  const struct pipe_item *i1 = a, *i2 = b;
+  int cmp = _pipe_strcmp(i1, i2);
+  if (cmp != 0)
+    return cmp;
+  return (i1->seq > i2->seq) - (i1->seq < i2->seq);
+}
+
+int
+_pipe_cmp_str_desc(const void *a, const void *b)
+{
+  /* Private qsort() function for pipeline(), string descending. */
+  const struct pipe_item *i1 = a, *i2 = b;
+  int cmp = _pipe_strcmp(i2, i1);
+  if (cmp != 0)
+    return cmp;
+  return (i1->seq > i2->seq) - (i1->seq < i2->seq);
+}
+
+
+void
+_pipeline_parse_stage(const char *str, size_t len, struct pipe_stage *stage)
+{
+  /*
+   * Private function for pipeline(), parses the $str stage
+   * (of length $len) into $stage.
+   * Exits with a fatal error if $str is not a valid stage.
+   */
+  char *desc, *name, *arg, *end;
+  long n;
+
+  if (NULL == (desc = malloc(len + 1)))
+    fatal(ext_id, "Can't allocate stage: %s", strerror(errno));
+  memcpy(desc, str, len);
+  desc[len] = '\0';
+  name = desc;
+  if (NULL != (arg = strchr(desc, ':')))
+    *arg++ = '\0';
+
+  stage->numeric = stage->desc = 0;
+  stage->n = 0;
+  stage->seen.items = NULL;
+  if (! strcmp(name, "flat") && arg == NULL) {
+    stage->kind = PIPE_FLAT;
+  } else if (! strcmp(name, "flat_idx") && arg == NULL) {
+    stage->kind = PIPE_FLAT_IDX;
+  } else if (! strcmp(name, "uniq") && arg == NULL) {
+    stage->kind = PIPE_UNIQ;
+  } else if (! strcmp(name, "sort")) {
+    stage->kind = PIPE_SORT;
+    // sort[:num|:str][:desc]
+    while (arg != NULL) {
+      name = arg;
+      if (NULL != (arg = strchr(name, ':')))
+	*arg++ = '\0';
+      if (! strcmp(name, "num"))
+	stage->numeric = 1;
+      else if (! strcmp(name, "str"))
+	stage->numeric = 0;
+      else if (! strcmp(name, "desc"))
+	stage->desc = 1;
+      else
+	fatal(ext_id, "Invalid pipeline() sort option: <%s>", name);
+    }
+  } else if ((! strcmp(name, "head") || ! strcmp(name, "tail")) && arg != NULL) {
+    stage->kind = (name[0] == 'h') ? PIPE_HEAD : PIPE_TAIL;
+    n = strtol(arg, & end, 10);
+    if (end == arg || *end != '\0' || n < 0)
+      fatal(ext_id, "Invalid pipeline() %s count: <%s>", name, arg);
+    stage->n = (size_t) n;
+  } else {
+    fatal(ext_id, "Invalid pipeline() stage: <%.*s>", (int) len, str);
+  }
+  free(desc);
+}
+
+
+size_t
+_pipeline_select(struct pipe_item *items, size_t len, size_t n,
+		 int (*cmp)(const void *, const void *))
+{
+  /*
+   * Private function for pipeline(), fused sort and head:
+   * moves the $n first $items (of $len) by $cmp to the front
+   * of $items, sorted, keeping only a $n items heap.
+   * Returns the new number of items.
+   */
+  size_t i, pos, child;
+  struct pipe_item tmp;
+
+  if (n >= len) {
+    qsort(items, len, sizeof(struct pipe_item), cmp);
+    return len;
+  }
+  if (n == 0)
+    return 0;
+  // max-heap (by cmp) of the first n items...
+  for (i = n / 2; i-- > 0; ) {
+    for (pos = i; (child = 2 * pos + 1) < n; pos = child) {
+      if (child + 1 < n && cmp(& items[child+1], & items[child]) > 0)
+	child += 1;
+      if (cmp(& items[pos], & items[child]) >= 0)
+	break;
+      tmp = items[pos]; items[pos] = items[child]; items[child] = tmp;
+    }
+  }
+  // ...replacing the root with any better item
+  for (i = n; i < len; i++) {
+    if (cmp(& items[i], & items[0]) >= 0)
+      continue;
+    items[0] = items[i];
+    for (pos = 0; (child = 2 * pos + 1) < n; pos = child) {
+      if (child + 1 < n && cmp(& items[child+1], & items[child]) > 0)
+	child += 1;
+      if (cmp(& items[pos], & items[child]) >= 0)
+	break;
+      tmp = items[pos]; items[pos] = items[child]; items[child] = tmp;
+    }
+  }
+  qsort(items, n, sizeof(struct pipe_item), cmp);
+  return n;
+}
+
+
+static awk_value_t*
+do_pipeline(int nargs,
+	    awk_value_t *result,
+	    __attribute__((unused)) struct awk_ext_func *finfo)
+{
+  /*
+   * Runs the stages described by $nargs[2] over the $nargs[0] array
+   * and puts the result in the $nargs[1] array *without* deleting
+   * elements already present in the latter, indexed with integer values
+   * starting from 0.
+   * $nargs[2] is either a string of stages separated by "|"
+   * (e.g. "flat|uniq|sort:num|head:100") or an array of stages
+   * indexed from 1 (or 0). Stages are:
+   *   flat      (deep) values of the source, as deep_flat() does
+   *   flat_idx  (deep) indexes of the source, as deep_flat_idx() does
+   *             (only as the first stage, defaults to flat if missing)
+   *   uniq      drops repeated values (compared as strings, as uniq() does)
+   *   sort[:num|:str][:desc]  sorts the values (by string, ascending, by default)
+   *   head:N    keeps the first N values
+   *   tail:N    keeps the last N values
+   * Stages run over a single native snapshot, never creating intermediate
+   * awk arrays, in which the string form of each value is computed once;
+   * leading uniq and head stages are applied while traversing
+   * the source (which stops once a head is full) and a sort followed by
+   * head only keeps the needed items.
+   * Exits with a fatal error if there are big issues, returns the
+   * number of elements put in $nargs[1].
+   */
+  assert(result != NULL);
+  make_number(0.0, result);
+
+  struct subarrays *list = NULL;
+  struct pipe_stage *stages = NULL;
+  struct pipe_item *items = NULL;
+  struct strmap seen;
+  awk_value_t dest_arr_value;
+  awk_value_t desc_val;
+  awk_value_t index_val;
+  awk_value_t value_val;
+  awk_array_t dest_array;
+  awk_flat_array_t *flat;
+  int (*cmp)(const void *, const void *);
+  const char *str, *sep;
+  const char *convfmt;
+  char buf[64];
+  char *keys = NULL;  // string keys of numbers
+  size_t keys_len = 0, keys_size = 0;
+  size_t nstages = 0, stages_size = 10, first = 0, streamed, s, count;
+  size_t i, j, len = 0, items_size = 1024, slen;
+  double start;
+  int on_idx = 0, found, stop = 0, need_str = 0;
+  size_t idx = 0;
+  size_t size = 0;
+  size_t maxsize = 10;
+
+  if (nargs != 3)
+    fatal(ext_id, "three args expected: source_array, dest_array, stages");
+  if (NULL == (list = alloc_subarray_list(list, maxsize)))
+    fatal(ext_id, "Can't allocate array lists: %s", strerror(errno));
+  if (! get_argument(0, AWK_ARRAY, & list[size].source_arr_value))
+    fatal(ext_id, "can't retrieve source array");
+  if (! get_argument(1, AWK_ARRAY, & dest_arr_value))
+    fatal(ext_id, "can't retrieve dest array");
+
+  fatal_if_same_array(list[size].source_arr_value.array_cookie,
+		      dest_arr_value.array_cookie, "pipeline()");
+
+  /* STAGES */
+  if (NULL == (stages = malloc(sizeof(struct pipe_stage) * stages_size)))
+    fatal(ext_id, "Can't allocate stages: %s", strerror(errno));
+  if (! get_argument(2, AWK_UNDEFINED, & desc_val))
+    fatal(ext_id, "can't retrieve stages (3rd arg)");
+  if (desc_val.val_type == AWK_ARRAY) {
+    if (! get_element_count(desc_val.array_cookie, & count))
+      fatal(ext_id, "can't get stages count");
+    make_number(0, & index_val);
+    start = get_array_element(desc_val.array_cookie, & index_val, AWK_STRING, & value_val) ? 0 : 1;
+    for (i = 0; i < count; i++) {
+      make_number(start + i, & index_val);
+      if (! get_array_element(desc_val.array_cookie, & index_val, AWK_STRING, & value_val))
+	fatal(ext_id, "missing stage at index <%g>", start + i);
+      if (nstages == stages_size
+	  && NULL == (stages = realloc(stages, sizeof(struct pipe_stage) * (stages_size *= 2))))
+	fatal(ext_id, "Can't reallocate stages: %s", strerror(errno));
+      _pipeline_parse_stage(value_val.str_value.str, value_val.str_value.len, & stages[nstages++]);
+    }
+  } else if (desc_val.val_type == AWK_STRING || desc_val.val_type == AWK_STRNUM) {
+    for (str = desc_val.str_value.str; ; str = sep + 1) {
+      sep = strchr(str, '|');
+      slen = (sep == NULL) ? strlen(str) : (size_t) (sep - str);
+      if (nstages == stages_size
+	  && NULL == (stages = realloc(stages, sizeof(struct pipe_stage) * (stages_size *= 2))))
+	fatal(ext_id, "Can't reallocate stages: %s", strerror(errno));
+      _pipeline_parse_stage(str, slen, & stages[nstages++]);
+      if (sep == NULL)
+	break;
+    }
+  } else {
+    fatal(ext_id, "stages (3rd arg) must be a string or an array");
+  }
+  if (nstages == 0)
+    fatal(ext_id, "no pipeline() stages");
+  if (stages[0].kind == PIPE_FLAT || stages[0].kind == PIPE_FLAT_IDX) {
+    on_idx = (stages[0].kind == PIPE_FLAT_IDX);
+    first = 1;
+  }
+  for (s = first; s < nstages; s++) {
+    if (stages[s].kind == PIPE_FLAT || stages[s].kind == PIPE_FLAT_IDX)
+      fatal(ext_id, "flat and flat_idx must be the first pipeline() stage");
+    if (stages[s].kind == PIPE_UNIQ || (stages[s].kind == PIPE_SORT && ! stages[s].numeric))
+      need_str = 1;
+  }
+  // leading uniq and head stages are streamed
+  for (streamed = first;
+       streamed < nstages && (stages[streamed].kind == PIPE_UNIQ || stages[streamed].kind == PIPE_HEAD);
+       streamed++)
+    if (stages[streamed].kind == PIPE_UNIQ)
+      strmap_init(& stages[streamed].seen, 1024);
+  convfmt = get_convfmt();
+
+  /* SNAPSHOT */
+  if (NULL == (items = malloc(sizeof(struct pipe_item) * items_size)))
+    fatal(ext_id, "Can't allocate snapshot: %s", strerror(errno));
+  dest_array = dest_arr_value.array_cookie;                            // *** MANDATORY ***
+  list[size].source_array = list[size].source_arr_value.array_cookie;  // *** MANDATORY ***
+  size += 1;
+
+  do {
+    if (! flatten_array_typed(list[idx].source_array,
+			      & list[idx].source_flat_array,
+			      AWK_STRING, AWK_UNDEFINED)) {
+      // skip, see NOTE_A
+      list[idx].source_flat_array = NULL;
+      idx += 1;
+      continue;
+    }
+    flat = list[idx].source_flat_array;
+    for (i = 0; i < flat->count && ! stop; i++) {
+      if (flat->elements[i].value.val_type == AWK_ARRAY) {
+	list = grow_subarray_list(list, size, & maxsize);
+	list[size].source_array = flat->elements[i].value.array_cookie;
+	size += 1;
+	if (! on_idx)
+	  continue;
+      }
+      value_val = on_idx ? flat->elements[i].index : flat->elements[i].value;
+      // the string key, computed once for every uniq and string sort
+      if (need_str) {
+	str = scalar_to_str(value_val, buf, sizeof(buf), convfmt, & slen);
+      } else {
+	str = "";
+	slen = 0;
+      }
+      for (s = first; s < streamed; s++) {
+	if (stages[s].kind == PIPE_UNIQ) {
+	  strmap_get(& stages[s].seen, str, slen, & found);
+	  if (found)
+	    break;
+	} else if (stages[s].n > 0) {  // PIPE_HEAD
+	  stages[s].n -= 1;
+	} else {
+	  stop = 1;  // all the next items would be dropped here
+	  break;
+	}
+      }
+      if (s < streamed)
+	continue;
+      if (len == items_size
+	  && NULL == (items = realloc(items, sizeof(struct pipe_item) * (items_size *= 2))))
+	fatal(ext_id, "Can't reallocate snapshot: %s", strerror(errno));
+      items[len].value = value_val;
+      value_to_number(value_val, & items[len].num);
+      items[len].len = slen;
+      if (str == buf) {
+	// a converted number, its key goes in the keys pool
+	if (keys_len + slen > keys_size
+	    && NULL == (keys = realloc(keys, (keys_size = (keys_size + slen) * 2))))
+	  fatal(ext_id, "Can't reallocate snapshot keys: %s", strerror(errno));
+	memcpy(keys + keys_len, str, slen);
+	items[len].str = NULL;
+	items[len].off = keys_len;
+	keys_len += slen;
+      } else {
+	items[len].str = str;  // in the flattened arrays, released at the end
+      }
+      items[len].seq = len;
+      len += 1;
+    }
+    idx += 1;
+  } while (idx < size && ! stop);
+  // the keys pool doesn't move anymore
+  for (i = 0; i < len; i++)
+    if (items[i].str == NULL)
+      items[i].str = keys + items[i].off;
+
+  /* STAGES ON THE SNAPSHOT */
+  for (s = streamed; s < nstages; s++) {
+    switch (stages[s].kind) {
+    case PIPE_UNIQ:
+      strmap_init(& seen, len);
+      for (i = j = 0; i < len; i++) {
+	strmap_get(& seen, items[i].str, items[i].len, & found);
+	if (! found)
+	  items[j++] = items[i];
+      }
+      len = j;
+      strmap_free(& seen);
+      break;
+    case PIPE_SORT:
+      for (i = 0; i < len; i++)
+	items[i].seq = i;
+      if (stages[s].numeric)
+	cmp = stages[s].desc ? _pipe_cmp_num_desc : _pipe_cmp_num;
+      else
+	cmp = stages[s].desc ? _pipe_cmp_str_desc : _pipe_cmp_str;
+      if (s + 1 < nstages && stages[s+1].kind == PIPE_HEAD) {
+	// fused sort and head
+	len = _pipeline_select(items, len, stages[s+1].n, cmp);
+	s += 1;
+      } else {
+	qsort(items, len, sizeof(struct pipe_item), cmp);
+      }
+      break;
+    case PIPE_HEAD:
+      if (stages[s].n < len)
+	len = stages[s].n;
+      break;
+    case PIPE_TAIL:
+      if (stages[s].n < len) {
+	memmove(items, items + len - stages[s].n, sizeof(struct pipe_item) * stages[s].n);
+	len = stages[s].n;
+      }
+      break;
+    default:
+      break;
+    }
+  }
+
+  /* OUTPUT */
+  for (i = 0; i < len; i++) {
+    make_number(i, & index_val);
+    if (! copy_element(items[i].value, & value_val))
+      fatal(ext_id, "Unknown element at index <%zu> (val_type=%d)",
+	    i, items[i].value.val_type);
+    if (! set_array_element(dest_array, & index_val, & value_val))
+      fatal(ext_id, "set_array_element() failed at index <%zu>", i);
+  }
+  make_number(len, result);
+
+  // must be called before exit
+  release_subarrays(list, idx, 1, 0);
+  for (s = 0; s < nstages; s++)
+    if (stages[s].seen.items != NULL)
+      strmap_free(& stages[s].seen);
+  free(stages);
+  free(items);
+  free(keys);
+  free(list);
+  return result;
+}
+
+
+struct uniq_row {
+  awk_array_t array;
+  size_t next;  // next kept row with the same hash (1-based), 0 if none
+};
+
+
+uint64_t
+_uniq_rows_hash(awk_array_t row, awk_flat_array_t *fields)
+{
+  /*
+   * Private function for do_uniq_rows().
+   * Returns the hash of the $row record, or only of
+   * its $fields (if not NULL, values are the field names).
+   */
+  awk_value_t value_val;
+  uint64_t hash = 0;
+  size_t i;
+  if (fields == NULL)
+    return hash_array(row);
+  for (i = 0; i < fields->count; i++) {
+    if (! get_array_element(row, & fields->elements[i].value, AWK_UNDEFINED, & value_val))
+      hash += hash_element(fields->elements[i].value, 0);  // missing field
+    else if (value_val.val_type == AWK_ARRAY)
+      hash += hash_element(fields->elements[i].value, hash_array(value_val.array_cookie));
+    else
+      hash += hash_element(fields->elements[i].value, hash_value(value_val));
+  }
+  return hash;
+}
+
+
+int _uniq_rows_same(awk_array_t row1, awk_array_t row2);
+
+int
+_uniq_rows_same_value(awk_value_t value1, awk_value_t value2)
+{
+  /*
+   * Private function for do_uniq_rows().
+   * Returns 1 if $value1 and $value2 are equal scalars
+   * or equal (sub)records (see _uniq_rows_same()), 0 otherwise.
+   */
+  if (value1.val_type == AWK_ARRAY || value2.val_type == AWK_ARRAY)
+    return (value1.val_type == value2.val_type
+	    && _uniq_rows_same(value1.array_cookie, value2.array_cookie));
+  return compare_element(value1, value2);
+}
+
+
+int
+_uniq_rows_same(awk_array_t row1, awk_array_t row2)
+{
+  /*
+   * Private function for do_uniq_rows().
+   * Returns 1 if the (sub)records $row1 and $row2 hold the same
+   * elements, whatever their order (as _uniq_rows_hash() does),
+   * 0 otherwise. Each index of $row1 is looked up in $row2, subarrays
+   * are compared recursively and empty (sub)records are equal.
+   */
+  awk_flat_array_t *flat;
+  awk_value_t value_val;
+  size_t i, count1, count2;
+  int equal = 1;
+  if (! (get_element_count(row1, & count1) && get_element_count(row2, & count2)))
+    fatal(ext_id, "can't get element count of records");
+  if (count1 != count2)
+    return 0;
+  if (count1 == 0)
+    return 1;  // can't be flattened, see NOTE_A
+  if (! flatten_array_typed(row1, & flat, AWK_STRING, AWK_UNDEFINED))
+    fatal(ext_id, "can't flatten record");
+  for (i = 0; equal && i < flat->count; i++)
+    equal = (get_array_element(row2, & flat->elements[i].index, AWK_UNDEFINED, & value_val)
+	     && _uniq_rows_same_value(flat->elements[i].value, value_val));
+  if (! release_flattened_array(row1, flat))
+    eprint("release_flattened_array() failed on record\n");
+  return equal;
+}
+
+
+int
+_uniq_rows_equals(awk_array_t row1, awk_array_t row2, awk_flat_array_t *fields)
+{
+  /*
+   * Private function for do_uniq_rows().
+   * Returns 1 if the records $row1 and $row2 are equal (whatever
+   * the order of their elements), comparing only their $fields
+   * if not NULL, 0 otherwise.
+   */
+  awk_value_t value1, value2;
+  size_t i;
+  int found1, found2;
+  if (fields == NULL)
+    return _uniq_rows_same(row1, row2);
+  for (i = 0; i < fields->count; i++) {
+    found1 = get_array_element(row1, & fields->elements[i].value, AWK_UNDEFINED, & value1);
+    found2 = get_array_element(row2, & fields->elements[i].value, AWK_UNDEFINED, & value2);
+    if (found1 != found2)
+      return 0;
+    if (found1 && ! _uniq_rows_same_value(value1, value2))
+      return 0;
+  }
+  return 1;
+}
+
+
+static awk_value_t*
+do_uniq_rows(int nargs,
+	     awk_value_t *result,
+	     __attribute__((unused)) struct awk_ext_func *finfo)
+{
+  /*
+   * Copies in the $nargs[1] array the subarrays (records) of the
+   * $nargs[0] array which are unique, keeping the first occurrence
+   * (in index order, as @ind_num_asc: numeric indexes first) at its
+   * original index, *without* deleting elements already present
+   * in the former. Scalar elements of $nargs[0] are skipped.
+   * $nargs[2] (optional) is an array whose values are the names of
+   * the fields to compare, otherwise records are compared whole.
+   * Records are hashed by their (index, value) pairs, subarrays
+   * included, and only records with the same hash are compared
+   * (as array::equals() does, on the given fields only if any).
+   * Exits with a fatal error if there are big issues, returns the
+   * number of copied records.
+   */
+  assert(result != NULL);
+  make_number(0.0, result);
+
+  struct subarrays *list = NULL;
+  struct uniq_row *rows = NULL;
+  struct strmap seen;
+  awk_value_t source_arr_value, dest_arr_value, fields_arr_value;
+  awk_value_t index_val;
+  awk_array_t source_array, dest_array, fields_array = NULL;
+  awk_flat_array_t *flat, *fields = NULL;
+  awk_element_t **sorted;
+  awk_array_t row;
+  uint64_t hash;
+  size_t *pos;
+  size_t i, j, nrows = 0;
+  size_t idx = 0;
+  size_t size = 0;
+  size_t maxsize = 10;
+  int found, dup;
+
+  if (nargs < 2)
+    fatal(ext_id, "at least two args expected: source_array, dest_array");
+  if (nargs > 3)
+    fatal(ext_id, "too many arguments");
+  if (! get_argument(0, AWK_ARRAY, & source_arr_value))
+    fatal(ext_id, "can't retrieve source array");
+  if (! get_argument(1, AWK_ARRAY, & dest_arr_value))
+    fatal(ext_id, "can't retrieve dest array");
+
+  fatal_if_same_array(source_arr_value.array_cookie,
+		      dest_arr_value.array_cookie, "uniq_rows()");
+
+  source_array = source_arr_value.array_cookie;  // *** MANDATORY ***
+  dest_array = dest_arr_value.array_cookie;      // *** MANDATORY ***
+
+  if (nargs > 2) {
+    if (! get_argument(2, AWK_ARRAY, & fields_arr_value))
+      fatal(ext_id, "can't retrieve fields array (3rd arg)");
+    fields_array = fields_arr_value.array_cookie;
+    if (! flatten_array_typed(fields_array, & fields, AWK_STRING, AWK_STRING))
+      fatal(ext_id, "fields array (3rd arg) is empty");
+    for (i = 0; i < fields->count; i++)
+      if (fields->elements[i].value.val_type != AWK_STRING)
+	fatal(ext_id, "fields array (3rd arg) must hold only field names");
+  }
+
+  if (! flatten_array_typed(source_array, & flat, AWK_STRING, AWK_UNDEFINED)) {
+    dprint("could not flatten source array\n");
+    goto out;
+  }
+  if (NULL == (list = alloc_subarray_list(list, maxsize)))
+    fatal(ext_id, "Can't allocate array lists: %s", strerror(errno));
+  if (NULL == (rows = malloc(sizeof(struct uniq_row) * (flat->count + 1))))
+    fatal(ext_id, "Can't allocate records: %s", strerror(errno));
+  strmap_init(& seen, 16);
+  sorted = sort_flat_by_index(flat);
+
+  for (i = 0; i < flat->count; i++) {
+    if (sorted[i]->value.val_type != AWK_ARRAY) {
+      dprint("skip scalar at index <%s>\n", sorted[i]->index.str_value.str);
+      continue;
+    }
+    row = sorted[i]->value.array_cookie;
+    hash = _uniq_rows_hash(row, fields);
+    pos = strmap_get(& seen, (const char *) & hash, sizeof(hash), & found);
+    if (found) {
+      // same hash, confirm comparing the records with it
+      dup = 0;
+      for (j = *pos; j != 0; j = rows[j-1].next) {
+	if (_uniq_rows_equals(rows[j-1].array, row, fields)) {
+	  dup = 1;
+	  break;
+	}
+	if (rows[j-1].next == 0)
+	  break;
+      }
+      if (dup)
+	continue;
+      rows[j-1].next = nrows + 1;
+    } else {
+      *pos = nrows + 1;
+    }
+    rows[nrows].array = row;
+    rows[nrows].next = 0;
+    nrows += 1;
+
+    /* keep it */
+    if (! copy_element(sorted[i]->index, & index_val))
+      fatal(ext_id, "copy_element() failed on index <%s>", sorted[i]->index.str_value.str);
+    list = grow_subarray_list(list, size, & maxsize);
+    list[size].dest_array = set_subarray(dest_array, & index_val);
+    list[size].source_array = row;
+    size += 1;
+  }
+
+  if (NULL == (list = _deep_copy(list, & idx, & size, & maxsize)))
+    fatal(ext_id, "Can't copy records");
+  make_number((double) nrows, result);
+
+  /* MANDATORY -- must be called before exit */
+  release_subarrays(list, idx, 1, 0);
+  free(sorted);
+  free(rows);
+  free(list);
+  strmap_free(& seen);
+  if (! release_flattened_array(source_array, flat))
+    eprint("release_flattened_array() failed on source array\n");
+ out:
+  if (fields != NULL && ! release_flattened_array(fields_array, fields))
+    eprint("release_flattened_array() failed on fields array\n");
+  return result;
+}
+
+
+#define _PARTITION_BUFSIZE (256 * 1024)  // per-shard file buffer
+#define _PARTITION_MAX_SHARDS 65536       // max number of shards (2nd arg)
+#define _PARTITION_FD_MARGIN 16           // descriptors left to gawk with shard files
+
+
+void
+_partition_close(FILE **shard_files, char **shard_bufs, size_t nshards)
+{
+  /*
+   * Private function for do_partition().
+   * Closes the first $nshards $shard_files (NULL ones skipped) and
+   * frees their $shard_bufs, when failing halfway through opening them.
+   */
+  size_t shard;
+  for (shard = 0; shard < nshards; shard++) {
+    if (shard_files[shard] != NULL)
+      fclose(shard_files[shard]);
+    free(shard_bufs[shard]);
+  }
+  free(shard_files);
+  free(shard_bufs);
+}
+
+
+uint64_t
+_partition_hash(awk_element_t *element, int on_vals, awk_value_t *keycol,
+		char *buf, size_t bufsize, const char *convfmt)
+{
+  /*
+   * Private function for do_partition().
+   * Returns the hash of the partition key of $element, that is
+   * its index, or its value if $on_vals (a record's $keycol field
+   * if not NULL, the whole record otherwise).
+   * Keys are hashed by their string value, so 1 and "1" hash the same.
+   */
+  awk_value_t value_val;
+  const char *str;
+  size_t len;
+  if (! on_vals) {
+    str = scalar_to_str(element->index, buf, bufsize, convfmt, & len);
+    return hash_bytes(str, len, 0);
+  }
+  value_val = element->value;
+  if (value_val.val_type == AWK_ARRAY && keycol != NULL) {
+    if (! get_array_element(element->value.array_cookie, keycol, AWK_UNDEFINED, & value_val))
+      return hash_bytes("", 0, 0);  // missing field, as the empty string
+  }
+  if (value_val.val_type == AWK_ARRAY)
+    return hash_array(value_val.array_cookie);
+  str = scalar_to_str(value_val, buf, bufsize, convfmt, & len);
+  return hash_bytes(str, len, 0);
+}
+
+
+void
+_partition_escape(FILE *fp, const char *str, size_t len)
+{
+  /*
+   * Private function for do_partition().
+   * Writes to $fp the $len bytes of $str with backslash, TAB and
+   * newline escaped as "\\", "\t" and "\n", so that a shard line
+   * is always "path TAB value".
+   */
+  size_t i, from = 0;
+  for (i = 0; i < len; i++) {
+    if (str[i] != '\\' && str[i] != '\t' && str[i] != '\n')
+      continue;
+    fwrite(str + from, 1, i - from, fp);
+    fputc('\\', fp);
+    fputc(str[i] == '\t' ? 't' : (str[i] == '\n' ? 'n' : '\\'), fp);
+    from = i + 1;
+  }
+  fwrite(str + from, 1, len - from, fp);
+}
+
+
+void
+_partition_write(FILE *fp, awk_element_t *element,
+		 const char *subsep, size_t subsep_len, const char *convfmt)
+{
+  /*
+   * Private function for do_partition().
+   * Writes to $fp the $element as "path TAB value" lines, one per
+   * scalar, with path being the indexes joined by $subsep and
+   * both escaped by _partition_escape().
+   * Subarrays are written whole, depth first.
+   * Exits with a fatal error if fails.
+   */
+  struct subarrays *list = NULL;
+  awk_flat_array_t *flat;
+  const char *str;
+  char buf[64];
+  size_t i, len;
+  size_t idx = 0;
+  size_t size = 0;
+  size_t maxsize = 10;
+
+  if (element->value.val_type != AWK_ARRAY) {
+    str = scalar_to_str(element->value, buf, sizeof(buf), convfmt, & len);
+    _partition_escape(fp, element->index.str_value.str, element->index.str_value.len);
+    fputc('\t', fp);
+    _partition_escape(fp, str, len);
+    fputc('\n', fp);
+    return;
+  }
+  if (NULL == (list = alloc_subarray_list(list, maxsize)))
+    fatal(ext_id, "Can't allocate array lists: %s", strerror(errno));
+  list[size].source_array = element->value.array_cookie;
+  list[size].path = make_path(NULL, element->index, subsep, subsep_len);
+  size += 1;
+
+  do {
+    if (! flatten_array_typed(list[idx].source_array,
+			      & list[idx].source_flat_array,
+			      AWK_STRING, AWK_UNDEFINED)) {
+      // skip, see NOTE_A
+      list[idx].source_flat_array = NULL;
+      idx += 1;
+      continue;
+    }
+    flat = list[idx].source_flat_array;
+    for (i = 0; i < flat->count; i++) {
+      if (flat->elements[i].value.val_type == AWK_ARRAY) {
+	list = grow_subarray_list(list, size, & maxsize);
+	list[size].source_array = flat->elements[i].value.array_cookie;
+	list[size].path = make_path(list[idx].path, flat->elements[i].index,
+				    subsep, subsep_len);
+	size += 1;
+	continue;
+      }
+      str = scalar_to_str(flat->elements[i].value, buf, sizeof(buf), convfmt, & len);
+      _partition_escape(fp, list[idx].path, strlen(list[idx].path));
+      _partition_escape(fp, subsep, subsep_len);
+      _partition_escape(fp, flat->elements[i].index.str_value.str,
+			flat->elements[i].index.str_value.len);
+      fputc('\t', fp);
+      _partition_escape(fp, str, len);
+      fputc('\n', fp);
+    }
+    idx += 1;
+  } while (idx < size);
+
+  // must be called before exit
+  release_subarrays(list, idx, 1, 0);
+  for (i = 0; i < size; i++)
+    free(list[i].path);
+  free(list);
+}
+
+
+static awk_value_t*
+do_partition(int nargs,
+	     awk_value_t *result,
+	     __attribute__((unused)) struct awk_ext_func *finfo)
+{
+  /*
+   * Splits the elements of the $nargs[0] array in $nargs[1] shards,
+   * by the hash of their key modulo $nargs[1].
+   * If $nargs[2] is an array, it's cleared and filled with the shards,
+   * i.e. $nargs[2][shard][index] = $nargs[0][index] for shard
+   * in 0..$nargs[1]-1 (all created, even if empty).
+   * $nargs[1] must be an integer in 1.._PARTITION_MAX_SHARDS and,
+   * with shard files, less than the limit of open files by
+   * _PARTITION_FD_MARGIN.
+   * If $nargs[2] is a string, it's the prefix of the shard files
+   * (named $nargs[2] shard, overwritten if existing) in which the
+   * elements are written as text lines "path TAB value", with path
+   * being the indexes joined by SUBSEP, one line per scalar; in both,
+   * backslash, TAB and newline are written as "\\", "\t" and "\n".
+   * $nargs[3] (optional) is either "i" (the key is the element's
+   * index, the default) or "v" (the key is its value).
+   * $nargs[4] (optional, needs "v") is the name of the field holding
+   * the key in subarrays (records), otherwise records are keyed by
+   * their whole contents.
+   * Subarrays are never split, they go whole in the same shard.
+   * The same key always goes to the same shard, across runs too.
+   * Exits with a fatal error if there are big issues, returns the
+   * number of partitioned elements.
+   */
+  assert(result != NULL);
+  make_number(0.0, result);
+
+  struct subarrays *list = NULL;
+  awk_value_t source_arr_value, shards_val, dest_val, what, keycol_val;
+  awk_value_t index_val, value_val;
+  awk_array_t source_array, dest_array = NULL;
+  awk_array_t *shard_arrays = NULL;
+  awk_flat_array_t *flat;
+  awk_value_t *keycol = NULL;
+  FILE **shard_files = NULL;
+  char **shard_bufs = NULL;
+  char *filename;
+  long open_max;
+  int errno_save;
+  const char *subsep = NULL;
+  const char *convfmt;
+  char buf[64];
+  size_t subsep_len = 0;
+  size_t i, nshards, shard;
+  size_t idx = 0;
+  size_t size = 0;
+  size_t maxsize = 10;
+  int on_vals = 0;
+
+  if (nargs < 3)
+    fatal(ext_id, "at least three args expected: source_array, shards, dest_array_or_prefix");
+  if (nargs > 5)
+    fatal(ext_id, "too many arguments");
+  if (! get_argument(0, AWK_ARRAY, & source_arr_value))
+    fatal(ext_id, "can't retrieve source array");
+  if (! get_argument(1, AWK_NUMBER, & shards_val))
+    fatal(ext_id, "can't retrieve the number of shards (2nd arg)");
+  // check before the cast, out of range (or NaN) doubles don't convert
+  if (! (isfinite(shards_val.num_value)
+	 && shards_val.num_value >= 1
+	 && shards_val.num_value <= _PARTITION_MAX_SHARDS
+	 && shards_val.num_value == trunc(shards_val.num_value)))
+    fatal(ext_id, "the number of shards (2nd arg) must be an integer in 1..%d",
+	  _PARTITION_MAX_SHARDS);
+  nshards = (size_t) shards_val.num_value;
+
+  if (! get_argument(2, AWK_UNDEFINED, & dest_val))
+    fatal(ext_id, "can't retrieve dest array or prefix (3rd arg)");
+  if (dest_val.val_type == AWK_UNDEFINED) {
+    // untyped variable, make it an array
+    if (! get_argument(2, AWK_ARRAY, & dest_val))
+      fatal(ext_id, "can't retrieve dest array (3rd arg)");
+  }
+  switch (dest_val.val_type) {
+  case AWK_ARRAY:
+    fatal_if_same_array(source_arr_value.array_cookie,
+			dest_val.array_cookie, "partition()");
+    dest_array = dest_val.array_cookie;  // *** MANDATORY ***
+    break;
+  case AWK_STRING: case AWK_STRNUM:
+    if (dest_val.str_value.len == 0)
+      fatal(ext_id, "empty shard files prefix (3rd arg)");
+    break;
+  default:
+    fatal(ext_id, "3rd arg must be an array or a string, got <%s>",
+	  _val_types[dest_val.val_type]);
+  }
+
+  if (nargs > 3) {
+    if (! get_argument(3, AWK_STRING, & what))
+      fatal(ext_id, "can't retrieve partition() string choice (idx|val)");
+    if (what.str_value.len != 1)
+      fatal(ext_id, "Invalid partition() string choice (idx|val): <%s>", what.str_value.str);
+    switch (what.str_value.str[0]) {
+    case 'i':
+      on_vals = 0; break;
+    case 'v':
+      on_vals = 1; break;
+    default:
+      fatal(ext_id, "Invalid partition() string choice (idx|val): <%s>", what.str_value.str);
+    }
+  }
+  if (nargs > 4) {
+    if (! on_vals)
+      fatal(ext_id, "key field (5th arg) needs \"v\" (4th arg)");
+    if (! get_argument(4, AWK_STRING, & keycol_val))
+      fatal(ext_id, "can't retrieve key field (5th arg)");
+    keycol = & keycol_val;
+  }
+
+  source_array = source_arr_value.array_cookie;  // *** MANDATORY ***
+  convfmt = get_convfmt();
+
+  /* make the shards */
+  if (dest_array != NULL) {
+    if (! clear_array(dest_array))
+      fatal(ext_id, "can't clear dest array");
+    if (NULL == (shard_arrays = malloc(sizeof(awk_array_t) * nshards)))
+      fatal(ext_id, "Can't allocate shards: %s", strerror(errno));
+    for (shard = 0; shard < nshards; shard++) {
+      make_number((double) shard, & index_val);
+      shard_arrays[shard] = set_subarray(dest_array, & index_val);
+    }
+    if (NULL == (list = alloc_subarray_list(list, maxsize)))
+      fatal(ext_id, "Can't allocate array lists: %s", strerror(errno));
+  } else {
+    // all the shard files are open at once
+    open_max = sysconf(_SC_OPEN_MAX);
+    if (open_max > 0 && nshards > (size_t) open_max - _PARTITION_FD_MARGIN)
+      fatal(ext_id, "too many shard files (2nd arg): <%zu>, the limit of open files is <%ld>",
+	    nshards, open_max);
+    subsep = get_subsep(& subsep_len);
+    if (NULL == (shard_files = calloc(nshards, sizeof(FILE *)))
+	|| NULL == (shard_bufs = calloc(nshards, sizeof(char *)))
+	|| NULL == (filename = malloc(dest_val.str_value.len + 32)))
+      fatal(ext_id, "Can't allocate shard files: %s", strerror(errno));
+    for (shard = 0; shard < nshards; shard++) {
+      sprintf(filename, "%s%zu", dest_val.str_value.str, shard);
+      if (NULL == (shard_files[shard] = fopen(filename, "w"))
+	  || NULL == (shard_bufs[shard] = malloc(_PARTITION_BUFSIZE))
+	  || 0 != setvbuf(shard_files[shard], shard_bufs[shard], _IOFBF, _PARTITION_BUFSIZE)) {
+	errno_save = errno;
+	_partition_close(shard_files, shard_bufs, shard + 1);
+	fatal(ext_id, "can't open shard file <%s>: %s", filename, strerror(errno_save));
+      }
+    }
+    free(filename);
+  }
+
+  if (! flatten_array_typed(source_array, & flat, AWK_STRING, AWK_UNDEFINED)) {
+    dprint("could not flatten source array\n");
+    flat = NULL;
+  }
+  for (i = 0; flat != NULL && i < flat->count; i++) {
+    shard = hash_mix(_partition_hash(& flat->elements[i], on_vals, keycol,
+				     buf, sizeof(buf), convfmt)) % nshards;
+    if (shard_files != NULL) {
+      _partition_write(shard_files[shard], & flat->elements[i], subsep, subsep_len, convfmt);
+      continue;
+    }
+    if (! copy_element(flat->elements[i].index, & index_val))
+      fatal(ext_id, "copy_element() failed at index <%zu>", i);
+    if (flat->elements[i].value.val_type == AWK_ARRAY) {
+      // copy it later
+      list = grow_subarray_list(list, size, & maxsize);
+      list[size].source_array = flat->elements[i].value.array_cookie;
+      list[size].dest_array = set_subarray(shard_arrays[shard], & index_val);
+      size += 1;
+    } else {
+      if (! copy_element(flat->elements[i].value, & value_val))
+	fatal(ext_id, "Unknown element at index <%zu> (val_type=%d)",
+	      i, flat->elements[i].value.val_type);
+      if (! set_array_element(shard_arrays[shard], & index_val, & value_val))
+	fatal(ext_id, "set_array_element() failed on value at index <%zu>", i);
+    }
+  }
+  if (flat != NULL)
+    make_number((double) flat->count, result);
+
+  // must be called before exit
+  if (shard_files != NULL) {
+    for (shard = 0; shard < nshards; shard++) {
+      if (0 != fclose(shard_files[shard]))
+	fatal(ext_id, "can't write shard file <%s%zu>: %s",
+	      dest_val.str_value.str, shard, strerror(errno));
+      free(shard_bufs[shard]);
+    }
+    free(shard_files);
+    free(shard_bufs);
+  } else {
+    if (NULL == (list = _deep_copy(list, & idx, & size, & maxsize)))
+      fatal(ext_id, "Can't copy subarrays");
+    release_subarrays(list, idx, 1, 0);
+    free(list);
+    free(shard_arrays);
+  }
+  if (flat != NULL && ! release_flattened_array(source_array, flat))
+    eprint("release_flattened_array() failed on source array\n");
+  return result;
+}
+
+
+#define _CONVERT_SET 1     // value converted, to be set back
+#define _CONVERT_FAILED 2  // value not (or not entirely) convertible
+
+struct to_string_fmt {
+  char *fmt;            // NULL for the awk's way (see scalar_to_str())
+  int is_int;           // integer conversion, takes a long long
+  const char *convfmt;
+  char buf[256];
+};
+
+
+size_t
+_convert_leaves(awk_array_t array, int deep,
+		int (*convert)(awk_value_t *value, void *data), void *data)
+{
+  /*
+   * Private function for do_to_number() and do_to_string().
+   * Calls $convert on the scalars of $array (and of its
+   * subarrays if $deep), setting back in place the ones it
+   * marks with _CONVERT_SET.
+   * Returns the number of values marked with _CONVERT_FAILED.
+   * Exits with a fatal error if fails.
+   */
+  struct subarrays *list = NULL;
+  awk_flat_array_t *flat;
+  awk_value_t index_val, value_val;
+  size_t i, failed = 0;
+  size_t idx = 0;
+  size_t size = 0;
+  size_t maxsize = 10;
+  int res;
+
+  if (NULL == (list = alloc_subarray_list(list, maxsize)))
+    fatal(ext_id, "Can't allocate array lists: %s", strerror(errno));
+  list[size].source_array = array;
+  size += 1;
+
+  do {
+    if (! flatten_array_typed(list[idx].source_array,
+			      & list[idx].source_flat_array,
+			      AWK_STRING, AWK_UNDEFINED)) {
+      // skip, see NOTE_A
+      list[idx].source_flat_array = NULL;
+      idx += 1;
+      continue;
+    }
+    flat = list[idx].source_flat_array;
+    for (i = 0; i < flat->count; i++) {
+      if (flat->elements[i].value.val_type == AWK_ARRAY) {
+	if (deep) {
+	  list = grow_subarray_list(list, size, & maxsize);
+	  list[size].source_array = flat->elements[i].value.array_cookie;
+	  size += 1;
+	}
+	continue;
+      }
+      value_val = flat->elements[i].value;
+      res = convert(& value_val, data);
+      if (res & _CONVERT_FAILED)
+	failed += 1;
+      if (! (res & _CONVERT_SET))
+	continue;
+      // replaces the element's value, which is not read anymore
+      make_const_string(flat->elements[i].index.str_value.str,
+			flat->elements[i].index.str_value.len, & index_val);
+      if (! set_array_element(list[idx].source_array, & index_val, & value_val))
+	fatal(ext_id, "set_array_element() failed on value at index <%zu>", i);
+    }
+    idx += 1;
+  } while (idx < size);
+
+  // must be called before exit
+  release_subarrays(list, idx, 1, 0);
+  free(list);
+  return failed;
+}
+
+
+int
+_convert_to_number(awk_value_t *value, void *data)
+{
+  /*
+   * Private function for do_to_number(), see _convert_leaves().
+   * $data points to the strict flag: if true, values which are not
+   * entirely numeric are left as they are.
+   * Unassigned values are not numbers yet, they are left as they are.
+   */
+  int strict = *(int *) data;
+  double num;
+  int numeric;
+  if (value->val_type == AWK_NUMBER || value->val_type == AWK_UNDEFINED)
+    return 0;
+  numeric = value_to_number(*value, & num);
+  if (! numeric && strict)
+    return _CONVERT_FAILED;
+  make_number(num, value);
+  return numeric ? _CONVERT_SET : (_CONVERT_SET | _CONVERT_FAILED);
+}
+
+
+int
+_convert_to_string(awk_value_t *value, void *data)
+{
+  /*
+   * Private function for do_to_string(), see _convert_leaves().
+   * $data points to a struct to_string_fmt.
+   * Numbers which can't be formatted are left as they are.
+   */
+  struct to_string_fmt *fmt = data;
+  const char *str;
+  double num;
+  size_t len;
+  int n;
+  switch (value->val_type) {
+  case AWK_STRING:
+    return 0;
+  case AWK_STRNUM: case AWK_REGEX:
+    // same text, as plain string
+    make_const_string(value->str_value.str, value->str_value.len, value);
+    return _CONVERT_SET;
+  case AWK_UNDEFINED:
+    make_null_string(value);
+    return _CONVERT_SET;
+  default:
+    break;
+  }
+  if (fmt->fmt == NULL) {
+    str = scalar_to_str(*value, fmt->buf, sizeof(fmt->buf), fmt->convfmt, & len);
+    make_const_string(str, len, value);
+    return _CONVERT_SET;
+  }
+  if (! value_to_number(*value, & num))
+    return _CONVERT_FAILED;
+  if (fmt->is_int) {
+    if (! (num > -9.2e18 && num < 9.2e18))
+      return _CONVERT_FAILED;  // out of range, inf or nan
+    n = snprintf(fmt->buf, sizeof(fmt->buf), fmt->fmt, (long long) num);
+  } else {
+    n = snprintf(fmt->buf, sizeof(fmt->buf), fmt->fmt, num);
+  }
+  if (n < 0 || (size_t) n >= sizeof(fmt->buf))
+    return _CONVERT_FAILED;
+  make_const_string(fmt->buf, n, value);
+  return _CONVERT_SET;
+}
+
+
+char*
+_to_string_parse_fmt(const char *fmt, int *is_int)
+{
+  /*
+   * Private function for do_to_string().
+   * Checks that $fmt has exactly one number conversion (plus any %%),
+   * with no length modifiers, * or $.
+   * Returns a malloc'd copy of $fmt, with "ll" added to integer
+   * conversions (setting $is_int), exits with a fatal error if fails.
+   */
+  const char *p, *conv = NULL;
+  char *new_fmt;
+  size_t plen;
+
+  for (p = fmt; *p; p++) {
+    if (*p != '%')
+      continue;
+    if (p[1] == '%') {
+      p++;
+      continue;
+    }
+    if (conv != NULL)
+      fatal(ext_id, "Invalid format <%s>: more than one conversion", fmt);
+    p++;
+    p += strspn(p, "-+ #0'");
+    p += strspn(p, "0123456789");
+    if (*p == '.') {
+      p++;
+      p += strspn(p, "0123456789");
+    }
+    if (*p == '\0' || ! strchr("diouxXeEfFgGaA", *p))
+      fatal(ext_id, "Invalid format <%s>: bad conversion", fmt);
+    conv = p;
+  }
+  if (conv == NULL)
+    fatal(ext_id, "Invalid format <%s>: no conversion", fmt);
+
+  *is_int = (strchr("diouxX", *conv) != NULL);
+  if (NULL == (new_fmt = malloc(strlen(fmt) + 3)))
+    fatal(ext_id, "Can't allocate format: %s", strerror(errno));
+  plen = conv - fmt;
+  memcpy(new_fmt, fmt, plen);
+  if (*is_int) {
+    memcpy(new_fmt + plen, "ll", 2);
+    strcpy(new_fmt + plen + 2, conv);
+  } else {
+    strcpy(new_fmt + plen, conv);
+  }
+  return new_fmt;
+}
+
+
+static awk_value_t*
+do_to_number(int nargs,
+	     awk_value_t *result,
+	     __attribute__((unused)) struct awk_ext_func *finfo)
+{
+  /*
+   * Converts in place the values of the $nargs[0] array to numbers,
+   * the awk's way (as adding 0), i.e. strnums become the numbers
+   * they look like and other strings their leading numeric part
+   * (or 0). Unassigned values are left as they are.
+   * $nargs[1] (optional) if true, converts the subarrays' values too.
+   * $nargs[2] (optional) if true, only values which entirely look
+   * like numbers are converted, others are left as they are.
+   * Exits with a fatal error if there are big issues, returns the
+   * number of values which don't entirely look like numbers
+   * (converted or not).
+   */
+  assert(result != NULL);
+  make_number(0.0, result);
+
+  awk_value_t arr_value, deep_val, strict_val;
+  int deep = 0, strict = 0;
+
+  if (nargs < 1)
+    fatal(ext_id, "one arg expected: array");
+  if (nargs > 3)
+    fatal(ext_id, "too many arguments");
+  if (! get_argument(0, AWK_ARRAY, & arr_value))
+    fatal(ext_id, "can't retrieve array");
+  if (nargs > 1) {
+    if (! get_argument(1, AWK_NUMBER, & deep_val))
+      fatal(ext_id, "can't retrieve deep flag (2nd arg)");
+    deep = (deep_val.num_value != 0);
+  }
+  if (nargs > 2) {
+    if (! get_argument(2, AWK_NUMBER, & strict_val))
+      fatal(ext_id, "can't retrieve strict flag (3rd arg)");
+    strict = (strict_val.num_value != 0);
+  }
+
+  make_number((double) _convert_leaves(arr_value.array_cookie, deep,
+				       _convert_to_number, & strict),
+	      result);
+  return result;
+}
+
+
+static awk_value_t*
+do_to_string(int nargs,
+	     awk_value_t *result,
+	     __attribute__((unused)) struct awk_ext_func *finfo)
+{
+  /*
+   * Converts in place the values of the $nargs[0] array to strings.
+   * Numbers are formatted using $nargs[1] (optional), a printf-like
+   * format with one numeric conversion (e.g. "%.2f" or "%05d", no
+   * length modifiers), otherwise the awk's way (integral values as
+   * integers, the others using CONVFMT). Strnums become strings with
+   * the same text.
+   * $nargs[2] (optional) if true, converts the subarrays' values too.
+   * Exits with a fatal error if there are big issues, returns the
+   * number of values which can't be formatted (left as they are).
+   */
+  assert(result != NULL);
+  make_number(0.0, result);
+
+  awk_value_t arr_value, fmt_val, deep_val;
+  struct to_string_fmt fmt;
+  int deep = 0;
+
+  if (nargs < 1)
+    fatal(ext_id, "one arg expected: array");
+  if (nargs > 3)
+    fatal(ext_id, "too many arguments");
+  if (! get_argument(0, AWK_ARRAY, & arr_value))
+    fatal(ext_id, "can't retrieve array");
+  fmt.fmt = NULL;
+  fmt.is_int = 0;
+  if (nargs > 1) {
+    if (! get_argument(1, AWK_STRING, & fmt_val))
+      fatal(ext_id, "can't retrieve format (2nd arg)");
+    if (fmt_val.str_value.len > 0)
+      fmt.fmt = _to_string_parse_fmt(fmt_val.str_value.str, & fmt.is_int);
+  }
+  if (nargs > 2) {
+    if (! get_argument(2, AWK_NUMBER, & deep_val))
+      fatal(ext_id, "can't retrieve deep flag (3rd arg)");
+    deep = (deep_val.num_value != 0);
+  }
+  fmt.convfmt = get_convfmt();
+
+  make_number((double) _convert_leaves(arr_value.array_cookie, deep,
+				       _convert_to_string, & fmt),
+	      result);
+  free(fmt.fmt);
+  return result;
+}
+
+
 ////////////////////////////////////////////////////////////////
 ////////////////
 /* COMPILE WITH (me, not necessary you):
-crap0101@orange:~/test$ gcc -fPIC -shared -DHAVE_CONFIG_H -c -O -g -I/usr/include -iquote ~/local/include/awk -Wall -Wextra arrayfuncs.c && gcc -o arrayfuncs.so -shared arrayfuncs.o && cp arrayfuncs.so ~/local/lib/awk/
+crap0101@orange:~/test$ gcc -fPIC -shared -DHAVE_CONFIG_H -c -O -g -I/usr/include -iquote ~/local/include/awk -Wall -Wextra arrayfuncs.c && gcc -o arrayfuncs.so -shared arrayfuncs.o -lm && cp arrayfuncs.so ~/local/lib/awk/
+(add -DHAVE_PCRE2 ... -lpcre2-8 to allow PCRE2 regexes in array::grep, with "ip" or "vp")
 */
 
 /******* NOTES ***************************/
@@ -133,6 +133,16 @@ BEGIN {
     delete ___c
     delete ___b
 
+    # empty subarrays
+    ___c[1][0]
+    delete ___c[1][0]
+    ___c[2] = 2
+    testing::assert_true(array::copy(___c, ___b), 1, "array::copy(___c, ___b) (empty subarray)")
+    testing::assert_true(isarray(___b[1]) && length(___b[1]) == 0, 1, "array::copy(___c, ___b) (empty subarray) ___b[1]")
+    testing::assert_equal(___b[2], 2, 1, "array::copy(___c, ___b) (empty subarray) ___b[2]")
+    delete ___c
+    delete ___b
+
     # add some unassigned values
     @dprint("* set unassigned values to a")
     a["baz"]
@@ -367,6 +377,23 @@ BEGIN {
     testing::assert_equal(arrlib::sprintf_vals(_t1arr), arrlib::sprintf_vals(bigflat), 1,
 	"(sprintf_vals) _t1arr == bigflat")
 
+    # many subarrays in the same array (the subarrays list must grow on the way)
+    delete __many
+    for (i=0; i<50; i++) {
+	__many[i][0] = i
+	__many[i][1] = "x"
+    }
+    array::deep_flat(__many, __many_flat)
+    testing::assert_equal(arrlib::array_length(__many_flat), 100, 1, "deep_flat (many subarrays)")
+    delete __many_flat
+    array::deep_flat_idx(__many, __many_flat)
+    testing::assert_equal(arrlib::array_length(__many_flat), 150, 1, "deep_flat_idx (many subarrays)")
+    delete __many_flat
+    array::uniq(__many, __many_flat, "v")
+    testing::assert_equal(arrlib::array_length(__many_flat), 51, 1, "uniq (many subarrays)")
+    delete __many_flat
+    delete __many
+
     # TEST array::deep_flat_idx
     @dprint("* arr:") && arrlib::printa(arr)
     @dprint("* array::deep_flat_idx(arr, arri)")
@@ -584,6 +611,625 @@ BEGIN {
     testing::assert_true(array::equals(big_array, big_array), 1, "equals __dest2 __dest (deep)")
     testing::assert_true(array::equals(__dest2, __dest), 1, "equals __dest2 __dest (deep)")
 
+    # subarrays at different indexes
+    delete __a
+    delete __b
+    __a["x"][1] = 1
+    __b["y"][1] = 1
+    testing::assert_false(array::equals(__a, __b), 1, "! equals (different subarray indexes)")
+    delete __b
+    __b["x"][1] = 1
+    testing::assert_true(array::equals(__a, __b), 1, "equals (same subarray indexes)")
+    delete __a
+    delete __b
+
+    # many subarrays
+    delete __a
+    delete __b
+    for (i=0; i<50; i++)
+	__a[i]["v"] = i
+    array::copy(__a, __b)
+    testing::assert_true(array::equals(__a, __b), 1, "equals (many subarrays)")
+    __b[49]["v"] = 0
+    testing::assert_false(array::equals(__a, __b), 1, "! equals (many subarrays, one changed)")
+    delete __a
+    delete __b
+
+    # TEST array::slice
+    @dprint("* _prev_order = set_sort_order(\"@ind_num_asc\")")
+    _prev_order = awkpot::set_sort_order("@ind_num_asc")
+    # wrong args
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::slice(a, b, 0) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! slice: missing arg")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::slice(a, a, 0, 1) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! slice: slice on itself")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::slice(a, b, 0, 1, 0) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! slice: zero step")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::slice(a, b, 0, 1, 0.5) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! slice: fractional step")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::slice(a, b, 0, 1e300) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! slice: end out of range")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::slice(a, b, log(-1), 1) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! slice: nan start")
+
+    delete __arr
+    delete __dest
+    _make_flat_array(__arr, 20)
+    testing::assert_equal(array::slice(__arr, __dest, 5, 9), 5, 1, "slice __arr 5..9 (count)")
+    testing::assert_equal(arrlib::sprintf_vals(__dest, ":"), "5:6:7:8:9", 1, "slice __arr 5..9")
+    delete __dest
+    testing::assert_equal(array::slice(__arr, __dest, 9, 0, -3), 4, 1, "slice __arr 9..0 step -3 (count)")
+    testing::assert_equal(arrlib::sprintf_vals(__dest, ":"), "9:6:3:0", 1, "slice __arr 9..0 step -3")
+    delete __dest
+    # missing indexes are skipped
+    testing::assert_equal(array::slice(__arr, __dest, 15, 30), 5, 1, "slice __arr 15..30 (count)")
+    delete __dest
+    # subarrays are copied whole
+    _make_subarr(__arr, 10)
+    array::slice(__arr, __dest, 1, 1)
+    testing::assert_true(array::equals(__arr[1], __dest[0]), 1, "slice __arr 1..1 (subarray)")
+    delete __dest
+
+    # TEST array::range
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { array::range(a, 0, 1, 0) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! range: zero step")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { array::range(a, 0, -log(0)) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! range: infinite end")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { array::range(a, log(0), 0, -1) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! range: infinite start")
+    testing::assert_equal(array::range(__dest, 1, 5), 5, 1, "range 1..5 (count)")
+    testing::assert_equal(arrlib::sprintf_vals(__dest, ":"), "1:2:3:4:5", 1, "range 1..5")
+    delete __dest
+    testing::assert_equal(array::range(__dest, 1, 0, 0.25), 0, 1, "range 1..0 step 0.25 (empty)")
+    testing::assert_equal(array::range(__dest, 1, 0, -0.25), 5, 1, "range 1..0 step -0.25 (count)")
+    testing::assert_equal(arrlib::sprintf_vals(__dest, ":"), "1:0.75:0.5:0.25:0", 1, "range 1..0 step -0.25")
+    delete __dest
+    @dprint("* set_sort_order(_prev_order)")
+    awkpot::set_sort_order(_prev_order)
+
+    # TEST array::memsize
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { array::memsize() }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! memsize: no args")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::memsize(a, a) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! memsize: profile on itself")
+
+    _make_flat_array(__arr, 10)
+    _msize = array::memsize(__arr)
+    @dprint(sprintf("* array::memsize(__arr) = %d", _msize))
+    testing::assert_true(_msize > 0, 1, "memsize __arr > 0")
+    __arr[10] = "a long string value, a long string value"
+    testing::assert_true(array::memsize(__arr) > _msize, 1, "memsize __arr grows with strings")
+
+    _make_subarr(__arr, 10)
+    __arr[1][0] = "foo"
+    array::memsize(__arr, __prof)
+    @dprint("* __prof:") && arrlib::printa(__prof)
+    testing::assert_equal(__prof["arrays"], 6, 1, "memsize __prof[arrays]")
+    testing::assert_equal(__prof["subarrays"], 5, 1, "memsize __prof[subarrays]")
+    testing::assert_equal(__prof["scalars"], 55, 1, "memsize __prof[scalars]")
+    testing::assert_equal(__prof["strings"], 1, 1, "memsize __prof[strings]")
+    testing::assert_equal(__prof["depth"][1], 10, 1, "memsize __prof[depth][1]")
+    testing::assert_equal(__prof["depth"][2], 50, 1, "memsize __prof[depth][2]")
+    testing::assert_equal(__prof["fanout"][2], 10, 1, "memsize __prof[fanout][2]")
+    testing::assert_equal(arrlib::array_length(__prof["largest"]), 5, 1, "memsize __prof[largest] length")
+    testing::assert_equal(__prof["largest"][1], 10, 1, "memsize __prof[largest][1]")
+    delete __prof
+    delete __arr
+    for (i=0; i<20; i++)
+	__arr["x"]["y"][i] = i
+    array::memsize(__arr, __prof)
+    testing::assert_equal(__prof["largest"]["x" SUBSEP "y"], 20, 1, "memsize __prof[largest][x,y]")
+    testing::assert_equal(__prof["largest"]["x"], 1, 1, "memsize __prof[largest][x]")
+    delete __prof
+
+    # TEST array::sample
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::sample(a, b) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! sample: missing arg")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::sample(a, a, 1) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! sample: sample on itself")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::sample(a, b, 1, 1, 1, \"x\") }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! sample: wrong kind")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::sample(a, b, -log(0)) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! sample: infinite size")
+
+    _make_subarr(__arr, 10)
+    testing::assert_equal(array::sample(__arr, __dest, 7, 42), 7, 1, "sample __arr 7 (count)")
+    testing::assert_equal(arrlib::array_length(__dest), 7, 1, "sample __arr 7 (length)")
+    _ok = 1
+    for (i in __dest) {
+	split(i, _path, SUBSEP)
+	if (length(_path) == 1 ? __arr[_path[1]] != __dest[i] : __arr[_path[1]][_path[2]] != __dest[i])
+	    _ok = 0
+    }
+    testing::assert_true(_ok, 1, "sample __arr 7 (paths)")
+    array::sample(__arr, __dest2, 7, 42)
+    testing::assert_true(array::equals(__dest, __dest2), 1, "sample __arr 7 (same seed)")
+    delete __dest
+    delete __dest2
+    # more than available
+    testing::assert_equal(array::sample(__arr, __dest, 100, 1), 55, 1, "sample __arr 100 (count)")
+    delete __dest
+    testing::assert_equal(array::sample(__arr, __dest, 100, 1, 0), 5, 1, "sample __arr 100 (no deep)")
+    delete __dest
+    testing::assert_equal(array::sample(__arr, __dest, 2, 1, 1, "s"), 12, 1, "sample __arr 2 (stratified)")
+    delete __dest
+    delete __arr
+    for (i=0; i<100; i++)
+	__arr[i] = (i % 10) ? 0 : 1
+    testing::assert_equal(array::sample(__arr, __dest, 20, 1, 1, "w"), 10, 1, "sample __arr 20 (weighted, count)")
+    for (i in __dest)
+	testing::assert_equal(__dest[i], 1, 1, sprintf("sample __arr 20 (weighted) at index %s", i))
+    delete __dest
+    # many subarrays, a huge size and a negative seed
+    delete __arr
+    for (i=0; i<300; i++)
+	for (j=0; j<4; j++)
+	    __arr[i][j] = i * 4 + j
+    testing::assert_equal(array::sample(__arr, __dest, 10, -5), 10, 1, "sample (many subarrays) count")
+    _ok = 1
+    for (i in __dest) {
+	split(i, _path, SUBSEP)
+	if (__arr[_path[1]][_path[2]] != __dest[i])
+	    _ok = 0
+    }
+    testing::assert_true(_ok, 1, "sample (many subarrays) paths")
+    array::sample(__arr, __dest2, 10, -5)
+    testing::assert_true(arrlib::equals(__dest, __dest2), 1, "sample (many subarrays) same negative seed")
+    delete __dest
+    delete __dest2
+    testing::assert_equal(array::sample(__arr, __dest, 3, 1, 1, "s"), 900, 1, "sample (many subarrays, stratified) count")
+    delete __dest
+    testing::assert_equal(array::sample(__arr, __dest, 1e300, 1), 1200, 1, "sample (many subarrays, huge size) count")
+    delete __dest
+    delete __arr
+
+    # TEST array::transpose
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0][0];a[1][1]; array::transpose(a) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! transpose: missing arg")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0][0];a[1][1]; array::transpose(a, a) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! transpose: transpose on itself")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0][\"c\"]=1; b[\"c\"]=2; array::transpose(a, b) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! transpose: scalar dest column")
+
+    delete __arr
+    for (i=0; i<4; i++)
+	for (j=0; j<3; j++)
+	    __arr[i][j] = i*10+j
+    __arr[2]["x"]["deep"] = "foo"
+    testing::assert_true(array::transpose(__arr, __dest), 1, "transpose __arr")
+    testing::assert_equal(arrlib::array_length(__dest), 4, 1, "transpose __arr (cols)")
+    testing::assert_equal(arrlib::array_length(__dest[0]), 4, 1, "transpose __arr (rows)")
+    testing::assert_equal(__dest[1][3], 31, 1, "transpose __arr [1][3]")
+    testing::assert_equal(__dest["x"][2]["deep"], "foo", 1, "transpose __arr [x][2] (subarray)")
+    array::transpose(__dest, __dest2)
+    testing::assert_true(arrlib::equals(__arr, __dest2), 1, "transpose twice")
+    delete __dest
+    delete __dest2
+    __arr["scalar"] = 1
+    testing::assert_false(array::transpose(__arr, __dest), 1, "! transpose __arr (scalar row)")
+    delete __dest
+    # elements already in dest are kept
+    delete __arr
+    __arr["r1"]["c"] = 1
+    __arr["r2"]["c"] = 2
+    __dest["c"]["old"] = "kept"
+    __dest["other"] = "kept too"
+    testing::assert_true(array::transpose(__arr, __dest), 1, "transpose (existing dest)")
+    testing::assert_equal(__dest["c"]["old"], "kept", 1, "transpose (existing dest) [c][old]")
+    testing::assert_equal(__dest["c"]["r2"], 2, 1, "transpose (existing dest) [c][r2]")
+    testing::assert_equal(arrlib::array_length(__dest["c"]), 3, 1, "transpose (existing dest) [c] length")
+    testing::assert_equal(__dest["other"], "kept too", 1, "transpose (existing dest) [other]")
+    delete __dest
+
+    # TEST array::pivot
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0][0];a[1][1]; array::pivot(a, b, \"avg\") }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! pivot: wrong aggregation")
+
+    delete __arr
+    for (i=1; i<=4; i++)
+	for (j=0; j<3; j++)
+	    __arr[i][j] = i*10+j
+    __arr[5][0] = 1
+    testing::assert_true(array::pivot(__arr, __dest, "sum"), 1, "pivot __arr (sum)")
+    testing::assert_equal(__dest[0], 101, 1, "pivot __arr (sum) [0]")
+    testing::assert_equal(__dest[2], 108, 1, "pivot __arr (sum) [2]")
+    array::pivot(__arr, __dest, "count")
+    testing::assert_equal(__dest[0], 5, 1, "pivot __arr (count) [0]")
+    testing::assert_equal(__dest[1], 4, 1, "pivot __arr (count) [1]")
+    array::pivot(__arr, __dest, "min")
+    testing::assert_equal(__dest[0], 1, 1, "pivot __arr (min) [0]")
+    array::pivot(__arr, __dest, "max")
+    testing::assert_equal(__dest[1], 41, 1, "pivot __arr (max) [1]")
+    array::pivot(__arr, __dest, "first")
+    testing::assert_equal(__dest[2], 12, 1, "pivot __arr (first) [2]")
+    delete __dest
+    # non-numeric cells
+    __arr[6][0] = "n/a"
+    __arr[6][3] = "n/a"
+    testing::assert_false(array::pivot(__arr, __dest, "min"), 1, "! pivot __arr (min, non-numeric)")
+    testing::assert_equal(__dest[0], 1, 1, "pivot __arr (min, non-numeric) [0]")
+    testing::assert_false(3 in __dest, 1, "pivot __arr (min, non-numeric) [3] not set")
+    delete __dest
+    array::pivot(__arr, __dest, "sum")
+    testing::assert_equal(__dest[0], 101, 1, "pivot __arr (sum, non-numeric) [0]")
+    testing::assert_equal(__dest[3], 0, 1, "pivot __arr (sum, non-numeric) [3]")
+    delete __dest
+    testing::assert_true(array::pivot(__arr, __dest, "count"), 1, "pivot __arr (count, non-numeric)")
+    testing::assert_equal(__dest[0], 6, 1, "pivot __arr (count, non-numeric) [0]")
+    delete __dest
+    # mixed indexes: numeric ones first, by value, then strings
+    delete __arr
+    __arr["1a"]["c"] = "1a"
+    __arr["b"]["c"] = "b"
+    __arr[10]["c"] = 10
+    __arr[9]["c"] = 9
+    __arr["-nan"]["c"] = "-nan"
+    array::pivot(__arr, __dest, "first")
+    testing::assert_equal(__dest["c"], 9, 1, "pivot (first, mixed indexes)")
+    delete __dest
+    delete __arr["9"]
+    delete __arr["10"]
+    array::pivot(__arr, __dest, "first")
+    testing::assert_equal(__dest["c"], "-nan", 1, "pivot (first, string indexes)")
+    delete __dest
+
+    # TEST array::merge_sorted
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[1]=1; array::merge_sorted(b, \"n\") }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! merge_sorted: missing arrays")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[1]=1; array::merge_sorted(b, \"x\", a) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! merge_sorted: wrong mode")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[1]=1; array::merge_sorted(b, \"ns\", a) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! merge_sorted: both n and s")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[1]=1; array::merge_sorted(a, \"n\", a) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! merge_sorted: merge on itself")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[1]=1; a[3]=3; array::merge_sorted(b, \"n\", a) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! merge_sorted: sparse array")
+
+    @dprint("* _prev_order = set_sort_order(\"@ind_num_asc\")")
+    _prev_order = awkpot::set_sort_order("@ind_num_asc")
+    delete __arr
+    delete __arr1
+    delete __arr2
+    split("1 4 9 10", __arr)
+    split("2 4 100", __arr1)
+    array::range(__arr2, 0, 12, 3)
+    testing::assert_equal(array::merge_sorted(__dest, "n", __arr, __arr1, __arr2), 12, 1, "merge_sorted (n) count")
+    testing::assert_equal(arrlib::sprintf_vals(__dest, ":"), "0:1:2:3:4:4:6:9:9:10:12:100", 1, "merge_sorted (n)")
+    delete __dest
+    testing::assert_equal(array::merge_sorted(__dest, "nu", __arr, __arr1, __arr2), 10, 1, "merge_sorted (nu) count")
+    testing::assert_equal(arrlib::sprintf_vals(__dest, ":"), "0:1:2:3:4:6:9:10:12:100", 1, "merge_sorted (nu)")
+    delete __dest
+    split("a c e", __arr)
+    split("b c d", __arr1)
+    array::merge_sorted(__dest, "su", __arr, __arr1)
+    testing::assert_equal(arrlib::sprintf_vals(__dest, ":"), "a:b:c:d:e", 1, "merge_sorted (su)")
+    delete __dest
+    # already sorted big array
+    array::range(__arr, 1, 1000)
+    array::range(__arr1, 1, 1000, 2)
+    array::merge_sorted(__dest, "n", __arr, __arr1)
+    _ok = 1
+    for (i=1; i<arrlib::array_length(__dest); i++)
+	if (__dest[i-1] > __dest[i])
+	    _ok = 0
+    testing::assert_true(_ok, 1, "merge_sorted (n) big order")
+    testing::assert_equal(arrlib::array_length(__dest), 1500, 1, "merge_sorted (n) big length")
+    delete __dest
+    awkpot::set_sort_order(_prev_order)
+
+    # TEST array::grep
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::grep(a, b) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! grep: missing arg")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::grep(a, a, \"x\") }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! grep: grep on itself")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::grep(a, b, \"(\") }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! grep: invalid regex")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::grep(a, b, \"x\", \"k\") }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! grep: wrong string choice")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::grep(a, b, \"x\", \"vx\") }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! grep: wrong syntax choice")
+
+    delete __arr
+    __arr["foo"] = "spam"
+    __arr["bar"] = "eggs"
+    __arr["baz"] = 12
+    __arr["sub"]["x"] = "spam and eggs"
+    __arr["sub"]["y"] = 120
+    testing::assert_equal(array::grep(__arr, __dest, "^sp"), 1, 1, "grep (v) ^sp count")
+    testing::assert_equal(__dest["foo"], "spam", 1, "grep (v) ^sp")
+    delete __dest
+    testing::assert_equal(array::grep(__arr, __dest, @/^12/), 1, 1, "grep (v) regex constant")
+    testing::assert_equal(__dest["baz"], 12, 1, "grep (v) regex constant, number value")
+    delete __dest
+    testing::assert_equal(array::grep(__arr, __dest, "^ba", "i"), 2, 1, "grep (i) ^ba count")
+    delete __dest
+    testing::assert_equal(array::grep(__arr, __dest, "^ba", "i", 1), 2, 1, "grep (i) ^ba inverted count")
+    testing::assert_true(array::equals(__arr["sub"], __dest["sub"]), 1, "grep (i) ^ba inverted, subarray")
+    delete __dest
+    testing::assert_equal(array::grep(__arr, __dest, "spam", "v", 0, 1), 2, 1, "grep (v) spam deep count")
+    testing::assert_equal(__dest["sub" SUBSEP "x"], "spam and eggs", 1, "grep (v) spam deep path")
+    delete __dest
+    # same pattern again, from the cache
+    testing::assert_equal(array::grep(__arr, __dest, "spam", "v", 1, 1), 3, 1, "grep (v) spam deep inverted count")
+    delete __dest
+    # the whole string is matched, past embedded NULs
+    delete __arr
+    __arr["nul"] = sprintf("x%cspam", 0)
+    testing::assert_equal(array::grep(__arr, __dest, "spam$"), 1, 1, "grep (v) embedded NUL")
+    delete __dest
+
+    # TEST array::pipeline
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::pipeline(a, b) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! pipeline: missing arg")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::pipeline(a, a, \"flat\") }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! pipeline: pipeline on itself")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::pipeline(a, b, \"flat|foo\") }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! pipeline: unknown stage")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::pipeline(a, b, \"uniq|flat\") }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! pipeline: flat not first")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::pipeline(a, b, \"head:x\") }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! pipeline: wrong head count")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; split(\"\", s); array::pipeline(a, b, s) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! pipeline: no stages")
+
+    @dprint("* _prev_order = set_sort_order(\"@ind_num_asc\")")
+    _prev_order = awkpot::set_sort_order("@ind_num_asc")
+    delete __arr
+    for (i=0; i<30; i++)
+	__arr[i] = (i * 7) % 11
+    __arr["sub"]["a"] = 20
+    __arr["sub"]["b"] = 3
+    testing::assert_equal(array::pipeline(__arr, __dest, "flat|uniq|sort:num|head:4"), 4, 1, "pipeline flat|uniq|sort:num|head:4 count")
+    testing::assert_equal(arrlib::sprintf_vals(__dest, ":"), "0:1:2:3", 1, "pipeline flat|uniq|sort:num|head:4")
+    delete __dest
+    array::pipeline(__arr, __dest, "flat|uniq|sort:num:desc|head:2")
+    testing::assert_equal(arrlib::sprintf_vals(__dest, ":"), "20:10", 1, "pipeline flat|uniq|sort:num:desc|head:2")
+    delete __dest
+    testing::assert_equal(array::pipeline(__arr, __dest, "uniq"), 12, 1, "pipeline uniq count")
+    delete __dest2
+    array::uniq(__arr, __dest2)
+    testing::assert_equal(arrlib::array_length(__dest2), 12, 1, "pipeline uniq == uniq")
+    delete __dest
+    delete __dest2
+    array::pipeline(__arr, __dest, "flat|sort:num|tail:2")
+    testing::assert_equal(arrlib::sprintf_vals(__dest, ":"), "10:20", 1, "pipeline flat|sort:num|tail:2")
+    delete __dest
+    # numbers sorted by their string form
+    array::pipeline(__arr, __dest, "flat|uniq|sort:str:desc|head:3")
+    testing::assert_equal(arrlib::sprintf_vals(__dest, ":"), "9:8:7", 1, "pipeline flat|uniq|sort:str:desc|head:3")
+    delete __dest
+    array::pipeline(__arr, __dest, "flat|uniq|sort|head:3")
+    testing::assert_equal(arrlib::sprintf_vals(__dest, ":"), "0:1:10", 1, "pipeline flat|uniq|sort|head:3")
+    delete __dest
+    array::pipeline(__arr, __dest, "flat_idx|uniq")
+    array::deep_flat_idx(__arr, __dest2)
+    testing::assert_equal(arrlib::array_length(__dest), arrlib::array_length(__dest2), 1, "pipeline flat_idx|uniq")
+    delete __dest
+    delete __dest2
+    # stages as array
+    split("flat uniq sort:num:desc head:2", __stages, " ")
+    array::pipeline(__arr, __dest, __stages)
+    testing::assert_equal(arrlib::sprintf_vals(__dest, ":"), "20:10", 1, "pipeline (array stages)")
+    delete __dest
+    delete __stages
+    awkpot::set_sort_order(_prev_order)
+
+    # TEST array::uniq_rows
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0][0];a[1][0]; array::uniq_rows(a) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! uniq_rows: missing arg")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0][0];a[1][0]; array::uniq_rows(a, a) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! uniq_rows: uniq_rows on itself")
+
+    delete __arr
+    __arr[1]["name"] = "ann" ; __arr[1]["age"] = 30
+    __arr[2]["name"] = "bob" ; __arr[2]["age"] = 40
+    __arr[3]["name"] = "ann" ; __arr[3]["age"] = 30
+    __arr[4]["name"] = "ann" ; __arr[4]["age"] = 31 ; __arr[4]["tags"][1] = "x"
+    __arr[10]["name"] = "ann" ; __arr[10]["age"] = 31 ; __arr[10]["tags"][1] = "x"
+    __arr[5]["name"] = "ann" ; __arr[5]["age"] = 31 ; __arr[5]["tags"][1] = "y"
+    __arr["s"] = "scalar"
+    testing::assert_equal(array::uniq_rows(__arr, __dest), 4, 1, "uniq_rows count")
+    testing::assert_true((1 in __dest) && (2 in __dest) && (4 in __dest) && (5 in __dest), 1, "uniq_rows keeps first occurrences")
+    testing::assert_false((3 in __dest) || (10 in __dest) || ("s" in __dest), 1, "uniq_rows drops duplicates and scalars")
+    testing::assert_true(arrlib::equals(__dest[4], __arr[4]), 1, "uniq_rows copies records")
+    delete __dest
+    __fields[1] = "name"
+    testing::assert_equal(array::uniq_rows(__arr, __dest, __fields), 2, 1, "uniq_rows (name) count")
+    testing::assert_true((1 in __dest) && (2 in __dest), 1, "uniq_rows (name) keeps first occurrences")
+    delete __dest
+    __fields[2] = "tags"
+    testing::assert_equal(array::uniq_rows(__arr, __dest, __fields), 4, 1, "uniq_rows (name, tags) count")
+    delete __dest
+    delete __fields
+    # empty subarrays are equal
+    delete __arr
+    __arr[1]["name"] = "ann" ; __arr[1]["tags"][1] ; delete __arr[1]["tags"][1]
+    __arr[2]["name"] = "ann" ; __arr[2]["tags"][1] ; delete __arr[2]["tags"][1]
+    __arr[3]["name"] = "ann" ; __arr[3]["tags"]["x"]["y"] ; delete __arr[3]["tags"]["x"]["y"]
+    __arr[4]["name"] = "ann" ; __arr[4]["tags"]["x"]["y"] ; delete __arr[4]["tags"]["x"]["y"]
+    testing::assert_equal(array::uniq_rows(__arr, __dest), 2, 1, "uniq_rows (empty subarrays) count")
+    testing::assert_true((1 in __dest) && (3 in __dest), 1, "uniq_rows (empty subarrays) keeps first occurrences")
+    delete __dest
+    __fields[1] = "tags"
+    testing::assert_equal(array::uniq_rows(__arr, __dest, __fields), 2, 1, "uniq_rows (tags, empty subarrays) count")
+    delete __dest
+    delete __fields
+    delete __arr
+    # mixed indexes, the first occurrence is the lowest numeric index
+    __arr["1a"]["k"] = 1
+    __arr["b"]["k"] = 1
+    __arr[10]["k"] = 1
+    __arr[9]["k"] = 1
+    __arr[100]["k"] = 1
+    testing::assert_equal(array::uniq_rows(__arr, __dest), 1, 1, "uniq_rows (mixed indexes) count")
+    testing::assert_true(9 in __dest, 1, "uniq_rows (mixed indexes) keeps the lowest numeric index")
+    delete __dest
+    delete __arr
+    for (i=0; i<2000; i++) {
+	__arr[i]["k"] = i % 37
+	__arr[i]["j"] = i % 2
+    }
+    testing::assert_equal(array::uniq_rows(__arr, __dest), 74, 1, "uniq_rows (many records) count")
+    delete __dest
+    delete __arr
+    # the same records, built in different insertion orders
+    split("name age city tags zip", __fields)
+    for (i=1; i<=5; i++) {
+	__arr[1][__fields[i]] = i
+	__arr[2][__fields[6-i]] = 6-i
+	__arr[3]["sub"][__fields[i]] = i
+	__arr[4]["sub"][__fields[6-i]] = 6-i
+    }
+    testing::assert_equal(array::uniq_rows(__arr, __dest), 2, 1, "uniq_rows (insertion order) count")
+    testing::assert_true((1 in __dest) && (3 in __dest), 1, "uniq_rows (insertion order) keeps first occurrences")
+    delete __dest
+    delete __fields
+    delete __arr
+
+    # TEST array::partition
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::partition(a, 2) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! partition: missing arg")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::partition(a, 2, a) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! partition: partition on itself")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::partition(a, 0, b) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! partition: zero shards")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::partition(a, -2, b) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! partition: negative shards")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::partition(a, 2.5, b) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! partition: fractional shards")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::partition(a, log(-1), b) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! partition: NaN shards")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::partition(a, -log(0), b) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! partition: infinite shards")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::partition(a, 2^64, b) }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! partition: too many shards")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0];a[1]; array::partition(a, 2, b, \"i\", \"k\") }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! partition: key field on indexes")
+
+    delete __arr
+    for (i=0; i<100; i++) {
+	__arr[i]["k"] = i % 7
+	__arr[i]["v"][1] = i
+    }
+    __arr["s"] = "scalar"
+    testing::assert_equal(array::partition(__arr, 4, __dest), 101, 1, "partition count")
+    testing::assert_equal(arrlib::array_length(__dest), 4, 1, "partition shards")
+    _n = 0
+    for (i=0; i<4; i++)
+	_n += arrlib::array_length(__dest[i])
+    testing::assert_equal(_n, 101, 1, "partition total elements")
+    for (i=0; i<4; i++)
+	if (42 in __dest[i])
+	    break
+    testing::assert_true(arrlib::equals(__dest[i][42], __arr[42]), 1, "partition copies records whole")
+    delete __dest
+    array::partition(__arr, 4, __dest, "v", "k")
+    # records with the same key in the same shard
+    delete __shard_of
+    _ok = 1
+    for (i=0; i<4; i++)
+	for (j in __dest[i]) {
+	    if (j == "s")
+		continue
+	    _k = __dest[i][j]["k"]
+	    if ((_k in __shard_of) && __shard_of[_k] != i)
+		_ok = 0
+	    __shard_of[_k] = i
+	}
+    testing::assert_true(_ok, 1, "partition (v, k) same key same shard")
+    delete __shard_of
+    delete __dest
+    # same as above, two runs
+    array::partition(__arr, 3, __dest)
+    array::partition(__arr, 3, __dest2)
+    testing::assert_true(arrlib::equals(__dest, __dest2), 1, "partition is stable")
+    delete __dest
+    delete __dest2
+
+    # shard files
+    _t1 = sys::mktemp("/tmp")
+    testing::assert_equal(array::partition(__arr, 3, _t1 "_"), 101, 1, "partition (files) count")
+    _n = 0
+    for (i=0; i<3; i++) {
+	delete _t1arr
+	awkpot::read_file_arr(_t1 "_" i, _t1arr)
+	_n += arrlib::array_length(_t1arr)
+	sys::rm(_t1 "_" i)
+    }
+    testing::assert_equal(_n, arrlib::deep_length(__arr), 1, "partition (files) one line per scalar")
+    delete _t1arr
+    # escaped TAB, newline and backslash
+    delete __arr
+    __arr["a\tb"] = "x\ny\\z"
+    __arr["k"]["i\n"] = "v\tw"
+    testing::assert_equal(array::partition(__arr, 1, _t1 "_"), 2, 1, "partition (files, escapes) count")
+    awkpot::read_file_arr(_t1 "_0", _t1arr)
+    sys::rm(_t1 "_0")
+    testing::assert_equal(arrlib::array_length(_t1arr), 2, 1, "partition (files, escapes) one line per scalar")
+    _ok = 1
+    _found = 0
+    for (i in _t1arr) {
+	if (split(_t1arr[i], _path, "\t") != 2)
+	    _ok = 0
+	if (_t1arr[i] == "a\\tb\tx\\ny\\\\z")
+	    _found = 1
+    }
+    testing::assert_true(_ok, 1, "partition (files, escapes) one TAB per line")
+    testing::assert_true(_found, 1, "partition (files, escapes) scalar line")
+    delete _t1arr
+    # more shard files than the limit of open files
+    cmd = sprintf("ulimit -n 64; %s -l arrayfuncs 'BEGIN { a[0];a[1]; array::partition(a, 100, \"%s_\") }'", ARGV[0], _t1)
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! partition: too many shard files")
+    sys::rm(_t1)
+    delete __arr
+
+    # TEST array::to_number / array::to_string
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { array::to_number() }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! to_number: missing arg")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0]; array::to_string(a, \"%%d %%d\") }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! to_string: two conversions")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0]; array::to_string(a, \"%%s\") }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! to_string: string conversion")
+    cmd = sprintf("%s -l arrayfuncs 'BEGIN { a[0]; array::to_string(a, \"%%ld\") }'", ARGV[0])
+    testing::assert_false(awkpot::exec_command(cmd), 1, "! to_string: length modifier")
+
+    delete __arr
+    split("12 3.5 7x foo", __arr, " ")
+    __arr["sub"]["x"] = __arr[1]
+    testing::assert_equal(typeof(__arr[1]), "strnum", 1, "to_number: strnum before")
+    testing::assert_equal(array::to_number(__arr), 2, 1, "to_number failures")
+    testing::assert_equal(typeof(__arr[1]), "number", 1, "to_number: number after")
+    testing::assert_equal(__arr[3] + 0, 7, 1, "to_number: leading numeric part")
+    testing::assert_equal(typeof(__arr["sub"]["x"]), "strnum", 1, "to_number: subarrays untouched")
+    delete __arr
+    split("12 3.5 7x foo", __arr, " ")
+    __arr["sub"]["x"] = __arr[1]
+    testing::assert_equal(array::to_number(__arr, 1, 1), 2, 1, "to_number (deep, strict) failures")
+    testing::assert_equal(typeof(__arr["sub"]["x"]), "number", 1, "to_number (deep): subarrays")
+    testing::assert_equal(typeof(__arr[3]), "string", 1, "to_number (strict): left as is")
+    __arr["u"]
+    testing::assert_equal(array::to_number(__arr, 1, 1), 2, 1, "to_number (unassigned) failures")
+    testing::assert_equal(typeof(__arr["u"]), "unassigned", 1, "to_number: unassigned left as is")
+    delete __arr["u"]
+
+    testing::assert_equal(array::to_string(__arr, "", 1), 0, 1, "to_string failures")
+    testing::assert_equal(typeof(__arr[1]), "string", 1, "to_string: string after")
+    testing::assert_equal(__arr[2], "3.5", 1, "to_string: awk's way")
+    delete __arr
+    __arr[0] = 3.14159
+    __arr[1] = 42
+    __arr[2] = 1e30
+    testing::assert_equal(array::to_string(__arr, "%.2f"), 0, 1, "to_string (%.2f) failures")
+    testing::assert_equal(__arr[0] ":" __arr[1], "3.14:42.00", 1, "to_string (%.2f)")
+    delete __arr
+    __arr[0] = 3.14159
+    __arr[1] = 42
+    __arr[2] = 1e30
+    testing::assert_equal(array::to_string(__arr, "%05d"), 1, 1, "to_string (%05d) failures")
+    testing::assert_equal(__arr[0] ":" __arr[1], "00003:00042", 1, "to_string (%05d)")
+    testing::assert_equal(typeof(__arr[2]), "number", 1, "to_string (%05d): out of range left as is")
+    delete __arr
+
     # report...
     testing::end_test_report()
     testing::report()